@@ -0,0 +1,2566 @@
+#include "assembler.hpp"
+
+static std::string get_str(std::vector<std::string> op)
+{
+	std::string s = "";
+	for(auto i : op)
+		s += i;
+	return s;
+}
+
+static void writeReport(std::string report, std::string filename)
+{
+	std::ofstream output(filename);	
+
+	output << report;
+}
+
+bool source_cache::readSource(std::string filename, std::vector<source_line>& strs)
+{
+	std::ifstream input(filename);
+
+	if(!input.good())
+		return false;
+
+	readSource(input, filename, strs);
+	return true;
+}
+
+void source_cache::readSource(std::istream& input, std::string filename, std::vector<source_line>& strs)
+{
+	std::string tmp_line;
+	auto file = std::make_shared<const std::string>(filename);
+	size_t line_num = 0;
+
+	for(std::string line; std::getline(input, line);)
+	{
+		line_num++;
+
+		if(line == "" || line[0] == ';')
+			continue;
+
+		int i = 0;
+		while(line[i] == ' ')
+			i++;
+
+		for(; i < line.size(); i++)
+		{
+			if(line[i] == ';')
+				break;
+			if(line[i] == '\t' || line[i] == '\n')
+				continue;
+			tmp_line += line[i];
+		}
+
+		if(tmp_line != "")
+			strs.push_back({tmp_line, file, line_num});
+		tmp_line = "";
+	}
+}
+
+bool source_cache::readBinary(std::string filename, std::string& data)
+{
+	std::ifstream input(filename, std::ios::binary);
+
+	if(!input.good())
+		return false;
+
+	std::stringstream s;
+	s << input.rdbuf();
+	data = s.str();
+
+	return true;
+}
+
+std::shared_ptr<const std::vector<source_line>> source_cache::getSource(std::string filename)
+{
+	std::unique_lock<std::mutex> lock(m);
+
+	// a prefetch or another job may be reading it already
+	read.wait(lock, [&] { return !reading.count(filename); });
+
+	auto f = sources.find(filename);
+
+	if(f != sources.end())
+		return f->second;
+
+	reading.insert(filename);
+	lock.unlock();
+
+	auto strs = std::make_shared<std::vector<source_line>>();
+	bool found = readSource(filename, *strs);
+
+	lock.lock();
+	reading.erase(filename);
+	read.notify_all();
+
+	if(!found)
+		return nullptr;
+
+	return sources.emplace(filename, strs).first->second;
+}
+
+void source_cache::setSource(std::string filename, const std::string& text)
+{
+	std::istringstream input(text);
+	auto strs = std::make_shared<std::vector<source_line>>();
+
+	readSource(input, filename, *strs);
+
+	std::lock_guard<std::mutex> lock(m);
+	sources[filename] = strs;
+}
+
+void source_cache::forget(std::string filename)
+{
+	std::lock_guard<std::mutex> lock(m);
+
+	sources.erase(filename);
+	binaries.erase(filename);
+}
+
+bool source_cache::getParsed(const std::string& text, bool illegal, std::vector<std::string>& res)
+{
+	std::lock_guard<std::mutex> lock(m);
+	auto f = parsed[illegal].find(text);
+
+	if(f == parsed[illegal].end())
+		return false;
+
+	res = f->second;
+	return true;
+}
+
+void source_cache::setParsed(const std::string& text, bool illegal, const std::vector<std::string>& res)
+{
+	std::lock_guard<std::mutex> lock(m);
+
+	if(parsed[illegal].size() < SHARED_PARSE_CACHE_SIZE)
+		parsed[illegal][text] = res;
+}
+
+std::shared_ptr<const std::string> source_cache::getBinary(std::string filename)
+{
+	std::unique_lock<std::mutex> lock(m);
+
+	read.wait(lock, [&] { return !reading.count(filename); });
+
+	auto f = binaries.find(filename);
+
+	if(f != binaries.end())
+		return f->second;
+
+	reading.insert(filename);
+	lock.unlock();
+
+	auto data = std::make_shared<std::string>();
+	bool found = readBinary(filename, *data);
+
+	lock.lock();
+	reading.erase(filename);
+	read.notify_all();
+
+	if(!found)
+		return nullptr;
+
+	return binaries.emplace(filename, data).first->second;
+}
+
+assembler::assembler(std::ostream& out, source_cache* cache) : out(&out), cache(cache)
+{
+	initDefs();
+}
+
+bool assembler::assemble(assemble_job job)
+{
+	result = analysis();
+	err_file = nullptr;
+	err_line = 0;
+	err_single = false;
+
+	// the include graph is read on other threads while pass 0 goes through it
+	prefetcher pf(cache, job.analyze ? 0 : job.prefetch_threads);
+
+	pf.start(job.filename);
+
+	try
+	{
+		passes(job);
+	}
+
+	catch(PASS_ERROR)
+	{
+		result.files = deps;
+		return false;
+	}
+
+	// a bug in a pass fails this job instead of every job in the batch
+	catch(const std::exception& e)
+	{
+		*out << "sfotasm: internal error: " << e.what() << std::endl;
+
+		result.failed = true;
+		result.error = std::string("Internal error: ") + e.what();
+		result.error_file = err_file;
+		result.error_line = err_line;
+		result.files = deps;
+		return false;
+	}
+
+	result.files = deps;
+	return true;
+}
+
+const analysis& assembler::getAnalysis()
+{
+	return result;
+}
+
+void assembler::err_show(PASS_ERROR err, int passnum, std::string instruction)
+{
+	std::string errs;
+
+	switch(err)
+	{
+		case UNKNOWN_INSTRUCTION:
+			errs = "Unknown instruction.";
+			break;
+		case ILLEGAL_ADR_TYPE:
+			errs = "Illegal addressing type for instruction.";
+			break;
+		case ORG_ADR_ERROR:
+			errs = "Illegal address for .org command.";
+			break;
+		case TOO_FAR_JMP:
+			errs = "Too far jump.";
+			break;
+		case UNKNOWN_PREPROC_INSTRUCTION:
+			errs = "Unknown preprocessing instruction.";
+			break;
+		case ILLEGAL_OPERAND:
+			errs = "Illegal operand.";
+			break;
+		case UNDEFINED_LABEL:
+			errs = "Undefined label.";
+			break;
+		case ILLEGAL_DEFINE:
+			errs = "Defined names must start with @";
+			break;
+		case BIN_FILE_NOT_FOUND:
+			errs = "Binary file not found.";
+			break;
+		case INPUT_FILE_NOT_FOUND:
+			errs = "Input file not found.";
+			break;
+		case OUTPUT_FILE_ERROR:
+			errs = "Can't write output file.";
+			break;
+		case UNDEFINED_ENTRY:
+			errs = "Profiler entry must be a code label.";
+			break;
+		case CYCLE_BUDGET_EXCEEDED:
+			errs = "Timed block exceeds its cycle budget.";
+			break;
+		case UNBOUNDED_TIMING:
+			errs = "Can't bound the cycle count of timed block.";
+			break;
+		case OPERAND_OUT_OF_RANGE:
+			errs = "Operand value out of range.";
+			break;
+		case MACRO_ERROR:
+			errs = "Bad macro definition or invocation.";
+			break;
+		case COMPRESSION_ERROR:
+			errs = "Can't compress data.";
+			break;
+		case VARIABLE_ERROR:
+			errs = "Bad .var declaration or allocation.";
+			break;
+		case POOL_ERROR:
+			errs = "Bad .pool block.";
+			break;
+		case FARCALL_ERROR:
+			errs = "Can't make trampolines for calls into other banks.";
+			break;
+		case RELOC_ERROR:
+			errs = "Bad .reloc section.";
+			break;
+		case SECTION_ERROR:
+			errs = "Can't place .section.";
+			break;
+		case PATCH_ERROR:
+			errs = "Can't make patch.";
+			break;
+		case CONDITION_ERROR:
+			errs = "Bad .if condition or unbalanced .if/.else/.endif.";
+			break;
+		case PAGE_CROSSED:
+			errs = ".nocross block crosses a page boundary.";
+			break;
+		case BANK_GEOMETRY_ERROR:
+			errs = "Bank size must be 8, 16 or 32 KB and set before the first .bank.";
+			break;
+		case LABEL_REDEFINED:
+			errs = "Label defined twice.";
+			break;
+	}
+
+	if(err_single && passnum <= 2)
+		*out << "sfotasm: error on the single pass: " << errs << std::endl;
+	else
+		*out << "sfotasm: error on PASS " << std::to_string(passnum) << ": " << errs << std::endl;
+	*out << "sfotasm: instruction: " << instruction << std::endl;
+
+	result.failed = true;
+	result.error = errs + " " + instruction;
+	result.error_file = err_file;
+	result.error_line = err_line;
+
+	throw err;
+}
+
+long assembler::evalOperand(std::string expr, std::map<std::string, size_t>& labels,
+	long lo, long hi, int passnum, std::string instruction)
+{
+	long v;
+
+	if(!ex.evaluate(expr, labels, v))
+		err_show(ex.isUndefined() ? UNDEFINED_LABEL : ILLEGAL_OPERAND, passnum, instruction + " (" + ex.getError() + ")");
+
+	if(v < lo || v > hi)
+		err_show(OPERAND_OUT_OF_RANGE, passnum, instruction);
+
+	return v;
+}
+
+std::string assembler::makeRelative(long target, size_t from, std::string instruction)
+{
+	long adr = target - (long)from;
+
+	if(adr < -0x80 || adr > 0x7F)
+		err_show(TOO_FAR_JMP, 2, instruction);
+
+	return hexNum(adr & 0xFF, 2);
+}
+
+long assembler::prresNum(const std::string& w, long lo, long hi, int passnum, std::string instruction)
+{
+	char* end = nullptr;
+	long v = std::strtol(w.c_str(), &end, 10);
+
+	if(w == "" || *end != '\0' || v < lo || v > hi)
+		err_show(ILLEGAL_OPERAND, passnum, instruction);
+
+	return v;
+}
+
+std::vector<source_line> assembler::makeVectorFromFile(std::string filename)
+{
+	std::vector<source_line> strs;
+
+	addDependency(filename);
+
+	if(cache)
+	{
+		auto src = cache->getSource(filename);
+
+		if(src)
+			return *src;
+	}
+
+	else if(source_cache::readSource(filename, strs))
+		return strs;
+
+	err_show(INPUT_FILE_NOT_FOUND, 0, filename);
+	return strs;
+}
+
+bool assembler::readBinary(std::string filename, std::string& data)
+{
+	addDependency(filename);
+
+	if(!cache)
+		return source_cache::readBinary(filename, data);
+
+	auto bin = cache->getBinary(filename);
+
+	if(!bin)
+		return false;
+
+	data = *bin;
+	return true;
+}
+
+void assembler::addDependency(std::string filename)
+{
+	if(std::find(deps.begin(), deps.end(), filename) == deps.end())
+		deps.push_back(filename);
+}
+
+void assembler::writeDependencies(assemble_job& job)
+{
+	std::string filename = job.depfilename;
+
+	if(filename == "")
+	{
+		size_t dot = job.resfilename.rfind('.');
+		size_t slash = job.resfilename.find_last_of("/\\");
+
+		if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+			dot = job.resfilename.length();
+
+		filename = job.resfilename.substr(0, dot) + ".d";
+	}
+
+	// spaces, # and $ are special in make
+	auto quote = [](std::string name)
+	{
+		std::string q = "";
+
+		for(auto c : name)
+		{
+			if(c == ' ' || c == '#')
+				q += '\\';
+			else if(c == '$')
+				q += '$';
+			q += c;
+		}
+
+		return q;
+	};
+
+	std::ofstream output(filename);
+
+	if(!output.good())
+		err_show(OUTPUT_FILE_ERROR, 2, filename);
+
+	output << quote(job.resfilename) << ":";
+
+	for(auto& d : deps)
+		output << " \\\n " << quote(d);
+
+	output << "\n";
+
+	// the input itself is no phony target, like with gcc
+	if(job.phony_deps)
+		for(size_t i(1); i < deps.size(); i++)
+			output << "\n" << quote(deps[i]) << ":\n";
+}
+
+void assembler::initDefs()
+{
+	def_addrs["@START"] = "$C000";
+	def_addrs["@INTS"] = "$FFFA";
+	def_addrs["@JOY1"] = "$4016";
+	def_addrs["@JOY2"] = "$4017";
+	def_addrs["@APU_PULSE1_CTRL"] = "$4000";
+	def_addrs["@APU_PULSE1_RCTRL"] = "$4001";
+	def_addrs["@APU_PULSE1_FT"] = "$4002";
+	def_addrs["@APU_PULSE1_CT"] = "$4003";
+
+	def_names = {"@START", "@INTS", "@JOY1", "@JOY2", "@APU_PULSE1_CTRL",
+				 "@APU_PULSE1_RCTRL", "@APU_PULSE1_FT", "@APU_PULSE1_CT"};
+}
+
+void assembler::passes(assemble_job& job)
+{
+	deps.clear();
+
+	auto insts = makeVectorFromFile(job.filename);
+
+	size_t bank = 0;
+	size_t real_adr = ROM_START_ADR;
+	size_t rsset = 0;
+	size_t instr_num = 0;
+
+	std::map<std::string, size_t> label_adrs;
+	std::map<size_t, size_t> rel_adrs;
+	std::vector<std::string> label_names;
+	std::vector<std::string> rs_names;
+	std::map<std::string, source_line> label_lines;
+	std::map<std::string, size_t> label_banks;
+
+	rom prg;
+	instructions inst;
+	preproc pr;
+	timing tm;
+	macros mc;
+
+	bool illegal = false;
+
+	// analysis runs parse only the lines that changed since the last one,
+	// jobs sharing a cache parse every line once
+	auto parse = [&](const std::string& text) -> std::vector<std::string>
+	{
+		if(!job.analyze && cache)
+		{
+			std::vector<std::string> res;
+
+			if(!cache->getParsed(text, illegal, res))
+			{
+				res = inst.parseInstruction(text);
+				cache->setParsed(text, illegal, res);
+			}
+
+			return res;
+		}
+
+		if(!job.analyze)
+			return inst.parseInstruction(text);
+
+		auto& known = parsed[illegal];
+		auto f = known.find(text);
+
+		if(f != known.end())
+			return f->second;
+
+		// edits leave old lines behind
+		if(known.size() > ANALYSIS_PARSE_CACHE_SIZE)
+			known.clear();
+
+		return known[text] = inst.parseInstruction(text);
+	};
+
+	auto locate = [&](const source_line& line)
+	{
+		err_file = line.file;
+		err_line = line.line;
+	};
+
+	std::map<std::string, std::string> user_def_addrs;
+	std::vector<std::string> user_def_names;
+
+	for(auto d : job.defines)
+	{
+		size_t eq = d.find('=');
+		std::string name = d.substr(0, eq);
+
+		if(name[0] != '@')
+			name = "@" + name;
+
+		user_def_names.push_back(name);
+		user_def_addrs[name] = eq == std::string::npos ? "1" : d.substr(eq+1);
+
+		if(job.analyze)
+			result.defines[name] = {user_def_addrs[name], nullptr, 0};
+	}
+
+	// PASS 0: add includes, expand macros, drop the false branches of .if
+
+	// defines seen so far, with their values when they are numbers
+	std::set<std::string> cond_names(user_def_names.begin(), user_def_names.end());
+	std::map<std::string, size_t> cond_values;
+
+	auto addCondDefine = [&](std::string name, std::string value)
+	{
+		long v;
+
+		cond_names.insert(name);
+
+		if(ex.evaluate(value, cond_values, v))
+			cond_values[name] = v;
+		else
+			cond_values.erase(name);
+	};
+
+	for(auto& d : user_def_names)
+		addCondDefine(d, user_def_addrs[d]);
+
+	auto condition = [&](std::string directive, std::string arg, std::string instruction) -> bool
+	{
+		arg.erase(std::remove(arg.begin(), arg.end(), ' '), arg.end());
+
+		if(directive == ".ifdef" || directive == ".ifndef")
+		{
+			if(arg != "" && arg[0] != '@')
+				arg = "@" + arg;
+
+			return (cond_names.count(arg) > 0) == (directive == ".ifdef");
+		}
+
+		long v;
+
+		if(!ex.evaluate(arg, cond_values, v))
+			err_show(CONDITION_ERROR, 0, instruction + " (" + ex.getError() + ")");
+
+		return v != 0;
+	};
+
+	auto directive = [](const std::string& text)
+	{
+		return text.substr(0, text.find(' '));
+	};
+
+	// first line after the false branch starting at from: the line after the
+	// .endif, or the one after an .else/.elseif that is taken. Only the first
+	// word of the skipped lines is looked at
+	auto skipBranch = [&](size_t from, bool find_else, size_t& end) -> bool
+	{
+		size_t depth = 0;
+
+		for(end = from; end < insts.size(); end++)
+		{
+			std::string d = directive(insts[end].text);
+
+			if(d == ".if" || d == ".ifdef" || d == ".ifndef")
+				depth++;
+
+			else if(d == ".endif")
+			{
+				if(depth == 0)
+				{
+					end++;
+					return false;
+				}
+				depth--;
+			}
+
+			else if(depth == 0 && find_else && d == ".else")
+			{
+				end++;
+				return true;
+			}
+
+			else if(depth == 0 && find_else && d == ".elseif" &&
+				condition(d, insts[end].text.substr(d.length()), insts[end].text))
+			{
+				end++;
+				return true;
+			}
+		}
+
+		err_show(CONDITION_ERROR, 0, insts[from-1].text + " (no .endif)");
+		return false;
+	};
+
+	size_t cond_depth = 0;
+
+	for(size_t i(0); i < insts.size(); i++)
+	{
+		locate(insts[i]);
+
+		std::istringstream words(insts[i].text);
+		std::string first;
+		words >> first;
+
+		if(first == ".if" || first == ".ifdef" || first == ".ifndef")
+		{
+			std::string arg;
+			std::getline(words, arg);
+
+			size_t end = i+1;
+
+			if(condition(first, arg, insts[i].text))
+				cond_depth++;
+			else if(skipBranch(i+1, true, end))
+				cond_depth++;
+
+			insts.erase(insts.begin()+i, insts.begin()+end);
+			i--;
+			continue;
+		}
+
+		if(first == ".else" || first == ".elseif" || first == ".endif")
+		{
+			if(cond_depth == 0)
+				err_show(CONDITION_ERROR, 0, insts[i].text);
+
+			// the branch before was taken, so the rest up to .endif is dropped
+			size_t end = i+1;
+
+			if(first != ".endif")
+				skipBranch(i+1, false, end);
+
+			cond_depth--;
+			insts.erase(insts.begin()+i, insts.begin()+end);
+			i--;
+			continue;
+		}
+
+		if(first == ".define")
+		{
+			std::string name, value;
+			words >> name >> value;
+
+			// the command line wins, every later pass sees only its value
+			if(user_def_addrs.count(name))
+			{
+				insts.erase(insts.begin()+i);
+				i--;
+				continue;
+			}
+
+			addCondDefine(name, value);
+		}
+
+		if(first == ".macro")
+		{
+			std::string name, params;
+			words >> name;
+			std::getline(words, params);
+
+			size_t end = i+1;
+
+			std::vector<std::string> body;
+
+			while(end < insts.size() && insts[end].text.compare(0, 5, ".endm") != 0)
+				body.push_back(insts[end++].text);
+
+			if(name == "" || end == insts.size())
+				err_show(MACRO_ERROR, 0, insts[i].text + " (no .endm)");
+
+			mc.define(name, pr.splitArgs(first + " " + params), body);
+
+			insts.erase(insts.begin()+i, insts.begin()+end+1);
+			i--;
+			continue;
+		}
+
+		if(first == ".rept")
+		{
+			auto args = pr.splitArgs(insts[i].text);
+			long count;
+
+			if(args.empty() || args.size() > 2 || !ex.evaluate(args[0], cond_values, count) || count < 0)
+				err_show(MACRO_ERROR, 0, insts[i].text + " (bad count)");
+
+			size_t end = i+1;
+			size_t depth = 0;
+
+			for(; end < insts.size(); end++)
+			{
+				std::string d = directive(insts[end].text);
+
+				if(d == ".rept")
+					depth++;
+				else if(d == ".endr" && depth-- == 0)
+					break;
+			}
+
+			if(end == insts.size())
+				err_show(MACRO_ERROR, 0, insts[i].text + " (no .endr)");
+
+			std::vector<std::string> body, lines;
+
+			for(size_t j(i+1); j < end; j++)
+				body.push_back(insts[j].text);
+
+			if(!mc.repeat(body, count, args.size() == 2 ? args[1] : "", lines))
+				err_show(MACRO_ERROR, 0, insts[i].text + " (" + mc.getError() + ")");
+
+			// repeated lines keep the place of their body line
+			std::vector<source_line> expanded;
+
+			for(size_t j(0); j < lines.size(); j++)
+				expanded.push_back({lines[j], insts[i+1 + j % body.size()].file, insts[i+1 + j % body.size()].line, insts[i].macro_depth});
+
+			insts.erase(insts.begin()+i, insts.begin()+end+1);
+			insts.insert(insts.begin()+i, expanded.begin(), expanded.end());
+			i--;
+			continue;
+		}
+
+		if(first == ".endr")
+			err_show(MACRO_ERROR, 0, insts[i].text + " (no .rept)");
+
+		if(mc.isMacro(first))
+		{
+			std::vector<std::string> lines;
+			source_line call = insts[i];
+
+			if(!mc.expand(first, pr.splitArgs(call.text), lines, call.macro_depth))
+				err_show(MACRO_ERROR, 0, call.text + " (" + mc.getError() + ")");
+
+			// expanded lines are listed at the invocation, invocations in them
+			// are expanded when the loop gets to them, after their .if lines
+			std::vector<source_line> expanded;
+
+			for(auto& l : lines)
+				expanded.push_back({l, call.file, call.line, call.macro_depth+1});
+
+			insts.erase(insts.begin()+i);
+			insts.insert(insts.begin()+i, expanded.begin(), expanded.end());
+			i--;
+			continue;
+		}
+
+		auto res = parse(insts[i].text);
+
+		if(res[0] == PREPROC_SIGN)
+		{
+			auto prres = pr.parsePreprocInstruction(insts[i].text);
+
+			if(prres[0] == PREPROC_INCLUDE_SIGN)
+			{
+				auto f = makeVectorFromFile(prres[1]);
+
+				insts.erase(insts.begin()+i);
+				insts.insert(insts.begin()+i, f.begin(), f.end());
+				i--;
+			}
+		}
+	}
+
+	err_file = nullptr;
+
+	if(cond_depth > 0)
+		err_show(CONDITION_ERROR, 0, ".if without .endif");
+
+	// --dce: drop the label blocks nothing reachable refers to, before
+	// anything counts or lays out their lines
+
+	deadcode dc;
+
+	if(job.dce)
+	{
+		std::set<std::string> data = {".db", ".dw", ".byte", ".word", ".table", ".tablew",
+			".for", ".forw", ".incbin", ".compress", ".endcompress"};
+		std::set<std::string> layout = {".org", ".bank", ".align", ".banksize", ".bankorg", ".reloc", ".endreloc",
+			".section", ".endsection"};
+
+		if(job.entry_label != "")
+			dc.addRoot(job.entry_label);
+
+		for(size_t i(0); i < insts.size(); i++)
+		{
+			auto& l = insts[i];
+			auto res = parse(l.text);
+			std::string first = l.text.substr(0, l.text.find_first_of(" \t"));
+
+			if(res[0] == COMMENT_SIGN)
+				continue;
+
+			if(res[0] == LABEL_SIGN)
+				dc.addLabel(i, res[1], *l.file + ":" + std::to_string(l.line));
+			else if(res[0] != PREPROC_SIGN)
+			{
+				for(auto& c : first)
+					c = ::toupper(c);
+
+				dc.addBody(i, l.text, first != "JMP" && first != "RTS" && first != "RTI");
+			}
+
+			else if(data.count(first))
+				dc.addBody(i, l.text, false);
+			else if(first == ".loop")
+				dc.addBody(i, l.text, true);
+			else if(layout.count(first))
+			{
+				dc.addLayout(l.text);
+
+				// the vector table is what the CPU starts from
+				std::string adr = l.text.substr(first.length());
+				adr.erase(std::remove_if(adr.begin(), adr.end(), ::isspace), adr.end());
+
+				if(first == ".org" && (adr == "@INTS" || adr == "$FFFA" || adr == "$fffa"))
+					dc.keepNext();
+			}
+
+			else
+				dc.addNeutral(l.text);
+		}
+
+		auto dead = dc.sweep();
+
+		for(auto i = dead.rbegin(); i != dead.rend(); i++)
+			insts.erase(insts.begin() + *i);
+	}
+
+	// .var allocation: zero page goes to the variables with the most
+	// references that a zp opcode can shorten, counted over the whole program
+
+	variables vars;
+
+	for(auto& l : insts)
+	{
+		if(l.text.compare(0, 4, ".var") != 0)
+			continue;
+
+		locate(l);
+
+		auto prres = pr.parsePreprocInstruction(l.text);
+
+		if(prres[0] == PREPROC_ERROR)
+			err_show(VARIABLE_ERROR, 1, l.text);
+
+		if(prres[0] == PREPROC_VARZP_SIGN)
+			vars.setZeroPage(prresNum(prres[1], 0, 0xFF, 1, l.text), prresNum(prres[2], 0, 0xFF, 1, l.text));
+		else if(prres[0] == PREPROC_VARRAM_SIGN)
+			vars.setRam(prresNum(prres[1], 0, 0xFFFF, 1, l.text), prresNum(prres[2], 0, 0xFFFF, 1, l.text));
+		else if(!vars.declare(prres[1], prresNum(prres[2], 0, 0xFFFF, 1, l.text), prres[3] == "zp" ? VAR_ZP : prres[3] == "ram" ? VAR_RAM : VAR_ANY))
+			err_show(VARIABLE_ERROR, 1, l.text + " (declared twice)");
+	}
+
+	err_file = nullptr;
+
+	std::map<std::string, size_t> var_adrs;
+
+	if(!vars.empty())
+	{
+		// executions per instruction of every label from the profile
+		std::map<std::string, double> executed;
+		std::map<std::string, size_t> block_size;
+		std::string block = "";
+
+		if(job.var_profile != "")
+		{
+			std::ifstream prof(job.var_profile);
+
+			if(!prof.good())
+				err_show(INPUT_FILE_NOT_FOUND, 1, job.var_profile);
+
+			for(std::string line; std::getline(prof, line);)
+			{
+				std::istringstream words(line);
+				std::string name, address, cycles, pc, calls;
+				double count;
+
+				if(line[0] != ';' && words >> name >> address >> cycles >> pc >> calls >> count && address[0] == '$')
+					executed[name] = count;
+			}
+
+			for(auto& l : insts)
+			{
+				auto res = parse(l.text);
+
+				if(res[0] == LABEL_SIGN)
+					block = res[1];
+				else if(res[0] != PREPROC_SIGN && res[0] != COMMENT_SIGN)
+					block_size[block]++;
+			}
+		}
+
+		block = "";
+
+		for(auto& l : insts)
+		{
+			auto res = parse(l.text);
+
+			if(res[0] == LABEL_SIGN)
+				block = res[1];
+
+			if(res[0] != LABEL_CALL_SIGN && res[0] != LABEL_ZP_SIGN && res[0] != LABEL_IMM_SIGN)
+				continue;
+
+			double weight = 1;
+
+			if(executed.count(block) && block_size[block])
+				weight += executed[block] / block_size[block];
+
+			bool shorter = res[0] == LABEL_CALL_SIGN && inst.getZeroPageOpcode(res[2]) != "";
+
+			for(auto& name : ex.getNames(res[1]))
+			{
+				if(!vars.isVariable(name))
+					continue;
+
+				if(res[0] == LABEL_ZP_SIGN)
+					vars.requireZeroPage(name);
+
+				vars.addReference(name, weight, shorter);
+			}
+		}
+
+		if(!vars.allocate())
+			err_show(VARIABLE_ERROR, 1, vars.getError());
+
+		var_adrs = vars.getAddresses();
+	}
+
+	// absolute operands made of zero page variables get the zp opcode
+	auto shorten = [&](std::vector<std::string>& res)
+	{
+		if(var_adrs.empty() || res[0] != LABEL_CALL_SIGN)
+			return;
+
+		std::string zp = inst.getZeroPageOpcode(res[2]);
+		long v;
+
+		if(zp != "" && ex.evaluate(res[1], var_adrs, v) && v >= 0 && v <= 0xFF)
+			res = {LABEL_ZP_SIGN, res[1], zp};
+	};
+
+	// .section: the layout around the sections is walked by size to know what
+	// each bank has taken, then every section gets a .bank and .org of its own
+
+	sections sc;
+	bool floating = false;
+	std::vector<float_section> floats;
+	std::vector<source_line> float_heads;
+	std::vector<std::vector<source_line>> float_lines;
+
+	for(auto& l : insts)
+		if(l.text.compare(0, 8, ".section") == 0)
+			floating = true;
+
+	// bytes by the same rules as pass 1, the sections are taken out of insts
+	auto layOut = [&](sections& into)
+	{
+		std::set<std::string> fixed_layout = {PREPROC_OFFSET_SIGN, PREPROC_BANK_SIGN, PREPROC_ALIGN_SIGN,
+			PREPROC_BANKSIZE_SIGN, PREPROC_BANKORG_SIGN, PREPROC_RELOC_SIGN, PREPROC_ENDRELOC_SIGN,
+			PREPROC_TRAMPOLINES_SIGN};
+
+		rom windows;
+		size_t cur = 0;
+		size_t adr = ROM_START_ADR;
+		std::vector<std::string> names = user_def_names;
+		auto addrs = user_def_addrs;
+		bool use_defs = false;
+		bool inside = false;
+		std::string method = "";
+		std::string data = "";
+		compression pk;
+		std::vector<source_line> pinned;
+
+		for(auto& l : insts)
+		{
+			locate(l);
+
+			std::string text = l.text;
+
+			for(auto& j : names)
+				for(size_t p = text.find(j); p != std::string::npos; p = text.find(j, p + addrs[j].length()))
+					text.replace(p, j.length(), addrs[j]);
+
+			if(use_defs)
+				for(auto& j : def_names)
+					for(size_t p = text.find(j); p != std::string::npos; p = text.find(j, p + def_addrs[j].length()))
+						text.replace(p, j.length(), def_addrs[j]);
+
+			auto res = parse(text);
+			size_t size = 0;
+			std::set<std::string> refs;
+
+			shorten(res);
+
+			if(res[0] == PREPROC_SIGN)
+			{
+				auto prres = pr.parsePreprocInstruction(text);
+
+				if(inside && fixed_layout.count(prres[0]))
+					err_show(SECTION_ERROR, 1, text + " (a .section has no fixed place)");
+
+				if(prres[0] == PREPROC_SECTION_SIGN)
+				{
+					if(inside)
+						err_show(SECTION_ERROR, 1, text + " (already in .section " + floats.back().name + ")");
+
+					inside = true;
+					floats.push_back({prres[1], 0, prres[2] == "1", std::stol(prres[3]), prres[4],
+						(size_t)std::stoi(prres[5]), prres[6] == "1", {}, {}, 0, 0});
+					float_heads.push_back(l);
+					float_lines.push_back({});
+					continue;
+				}
+
+				else if(prres[0] == PREPROC_ENDSECTION_SIGN)
+				{
+					if(!inside)
+						err_show(SECTION_ERROR, 1, text + " (no .section)");
+
+					inside = false;
+					continue;
+				}
+
+				else if(prres[0] == PREPROC_ERROR && text.compare(0, 8, ".section") == 0)
+				{
+					err_show(SECTION_ERROR, 1, text);
+				}
+
+				else if(prres[0] == PREPROC_DB_SIGN || prres[0] == PREPROC_DW_SIGN)
+				{
+					bool word = prres[0] == PREPROC_DW_SIGN;
+
+					for(size_t j(1); j < prres.size(); j++)
+					{
+						if(prres[j][0] == PREPROC_EXPR_PREFIX[0])
+						{
+							if(method != "")
+								err_show(SECTION_ERROR, 1, text + " (.compress data has to be constant to place sections)");
+
+							for(auto& name : ex.getNames(prres[j].substr(1)))
+								refs.insert(name);
+
+							continue;
+						}
+
+						if(method == "")
+							continue;
+
+						data += (char)std::stoi(prres[j].substr(0, 2), 0, 16);
+
+						if(word)
+							data += (char)std::stoi(prres[j].substr(2, 2), 0, 16);
+					}
+
+					size = (word ? 2 : 1) * (prres.size()-1);
+				}
+
+				else if(prres[0] == PREPROC_COMPRESS_SIGN)
+				{
+					method = prres[1];
+					data = "";
+				}
+
+				else if(prres[0] == PREPROC_ENDCOMPRESS_SIGN && method != "")
+				{
+					std::string packed;
+
+					if(!pk.pack(method, data, packed))
+						err_show(COMPRESSION_ERROR, 1, text + " (" + pk.getError() + ")");
+
+					size = packed.size();
+					method = "";
+				}
+
+				else if(prres[0] == PREPROC_INCBIN_SIGN && prres[2] != "")
+				{
+					std::string file, packed;
+
+					if(!readBinary(prres[1], file))
+						err_show(BIN_FILE_NOT_FOUND, 1, text);
+
+					if(!pk.pack(prres[2], file, packed))
+						err_show(COMPRESSION_ERROR, 1, text + " (" + pk.getError() + ")");
+
+					size = packed.size();
+				}
+
+				else if(prres[0] == PREPROC_TABLE_SIGN)
+				{
+					long from, to;
+
+					if(!ex.evaluate(prres[3], cond_values, from) || !ex.evaluate(prres[4], cond_values, to))
+						err_show(SECTION_ERROR, 1, text + " (the bounds have to be constant to place sections)");
+
+					size = to >= from ? (to - from + 1) * std::stoi(prres[1]) : 0;
+
+					for(auto& name : ex.getNames(prres[5]))
+						if(name != prres[2])
+							refs.insert(name);
+				}
+
+				else if(prres[0] == PREPROC_USE_DEFS_SIGN)
+				{
+					use_defs = true;
+				}
+
+				else if(prres[0] == PREPROC_DEFINE_SIGN)
+				{
+					names.push_back(prres[1]);
+					addrs[prres[1]] = prres[2];
+				}
+
+				else if(prres[0] == PREPROC_BANKSIZE_SIGN)
+				{
+					windows.setBankSizeKb(prresNum(prres[1], 0, 0xFF, 1, text));
+				}
+
+				else if(prres[0] == PREPROC_BANKORG_SIGN)
+				{
+					windows.setDefaultWindow(prresNum(prres[1], 0, 0xFFFF, 1, text));
+				}
+
+				else if(prres[0] == PREPROC_BANK_SIGN)
+				{
+					cur = prresNum(prres[1], 0, 0xFFFF, 1, text);
+
+					if(prres.size() > 2)
+						windows.setWindow(cur, prresNum(prres[2], 0, 0xFFFF, 1, text));
+					else if(!windows.isUsed(cur))
+						windows.setWindow(cur, windows.getDefaultWindow(cur));
+
+					windows.use(cur);
+					adr = windows.getWindow(cur);
+				}
+
+				else if(prres[0] == PREPROC_OFFSET_SIGN)
+				{
+					size_t org = prresNum(prres[1], 0, 0xFFFF, 1, text);
+
+					adr = org >= windows.getWindow(cur) ? org : org + windows.getWindow(cur);
+				}
+
+				else if(prres[0] == PREPROC_ALIGN_SIGN)
+				{
+					size_t n = prresNum(prres[1], 1, 0xFFFF, 1, text);
+					adr += (n - adr % n) % n;
+				}
+			}
+
+			else if(res[0] == LABEL_SIGN)
+			{
+				if(inside)
+					floats.back().labels.insert(res[1]);
+				else
+					into.addLabel(res[1], cur);
+			}
+
+			else if(res[0] == RELATIVE_SIGN || res[0] == RELATIVE_ADDR_SIGN || res[0] == LABEL_IMM_SIGN ||
+				res[0] == LABEL_ZP_SIGN || res[0] == LABEL_CALL_SIGN)
+			{
+				size = res[0] == LABEL_CALL_SIGN ? 3 : 2;
+
+				for(auto& name : ex.getNames(res[1]))
+					refs.insert(name);
+			}
+
+			else if(res[0] != COMMENT_SIGN && res[0] != ERROR_ILLEGAL_INSTRUCTION_SIGN && res[0] != ERROR_ILLEGAL_OPERAND_SIGN)
+			{
+				size = res.size();
+			}
+
+			if(inside)
+			{
+				floats.back().size += size;
+				floats.back().refs.insert(refs.begin(), refs.end());
+				float_lines.back().push_back(l);
+				continue;
+			}
+
+			// code before the first .bank is in bank 0
+			if(size > 0 && !windows.isUsed(cur))
+			{
+				windows.setWindow(cur, windows.getDefaultWindow(cur));
+				windows.use(cur);
+			}
+
+			if(!into.occupy(cur, adr, adr + size))
+				err_show(SECTION_ERROR, 1, text + " (overlaps other code at $" + hexNum(adr, 4) + " in bank " + std::to_string(cur) + ")");
+
+			into.addRefs(cur, refs);
+			adr += size;
+
+			pinned.push_back(l);
+		}
+
+		if(inside)
+			err_show(SECTION_ERROR, 1, float_heads.back().text + " (no .endsection)");
+
+		err_file = nullptr;
+		insts = pinned;
+
+		for(auto b : windows.getUsedBanks())
+			into.addBank(b, windows.getWindow(b), windows.getBankSize());
+	};
+
+	// the sections go after the pinned code
+	auto placeSections = [&]()
+	{
+		layOut(sc);
+
+		for(size_t i(0); i < floats.size(); i++)
+		{
+			locate(float_heads[i]);
+
+			if(!sc.add(floats[i]))
+				err_show(SECTION_ERROR, 1, float_heads[i].text + " (" + sc.getError() + ")");
+		}
+
+		err_file = nullptr;
+
+		if(!sc.place())
+			err_show(SECTION_ERROR, 1, sc.getError());
+
+		for(size_t i(0); i < floats.size(); i++)
+		{
+			auto& s = sc.getSections()[i];
+			auto& head = float_heads[i];
+
+			insts.push_back({".bank " + std::to_string(s.placed_bank), head.file, head.line});
+			insts.push_back({".org $" + hexNum(s.address, 4), head.file, head.line});
+			insts.insert(insts.end(), float_lines[i].begin(), float_lines[i].end());
+		}
+	};
+
+	if(floating)
+		placeSections();
+
+	// far calls: JSR/JMP to a label in a bank that shares its window goes
+	// through a trampoline at .trampolines, without one it is only reported
+
+	farcalls fc;
+	std::vector<std::pair<size_t, size_t>> calls;
+	long tramp_line = -1;
+	size_t tramp_bank = 0;
+
+	{
+		std::set<std::string> layout = {".bank", ".banksize", ".bankorg", ".ines", ".inesmap", ".trampolines"};
+		rom windows;
+		size_t cur = 0;
+		// code copied to RAM is called where it runs
+		bool relocated = false;
+		// defines as pass 1 substitutes them, for .bank @BANK and the like
+		std::vector<std::string> names = user_def_names;
+		auto addrs = user_def_addrs;
+		bool use_defs = false;
+
+		// by the text alone, most builds have no far calls
+		for(size_t i(0); i < insts.size(); i++)
+		{
+			auto& l = insts[i].text;
+			std::string word = l.substr(0, l.find_first_of(" \t"));
+			std::string first = word;
+
+			for(auto& c : first)
+				c = ::toupper(c);
+
+			// code before the first .bank is in bank 0
+			if((word.back() == ':' || first == "JSR" || first == "JMP") && !windows.isUsed(cur))
+			{
+				windows.setWindow(cur, windows.getDefaultWindow(cur));
+				windows.use(cur);
+			}
+
+			if(word == ".reloc" || word == ".endreloc")
+				relocated = word == ".reloc";
+
+			else if(word.back() == ':' && !relocated)
+				fc.addLabel(word.substr(0, word.length()-1), cur);
+
+			else if(first == "JSR" || first == "JMP")
+				calls.push_back({i, cur});
+
+			else if(word == ".define" || word == ".use")
+			{
+				auto prres = pr.parsePreprocInstruction(l);
+
+				if(prres[0] == PREPROC_DEFINE_SIGN)
+				{
+					names.push_back(prres[1]);
+					addrs[prres[1]] = prres[2];
+				}
+
+				else if(prres[0] == PREPROC_USE_DEFS_SIGN)
+					use_defs = true;
+			}
+
+			else if(layout.count(word))
+			{
+				locate(insts[i]);
+
+				std::string text = l;
+
+				for(auto& j : names)
+					for(size_t p = text.find(j); p != std::string::npos; p = text.find(j, p + addrs[j].length()))
+						text.replace(p, j.length(), addrs[j]);
+
+				if(use_defs)
+					for(auto& j : def_names)
+						for(size_t p = text.find(j); p != std::string::npos; p = text.find(j, p + def_addrs[j].length()))
+							text.replace(p, j.length(), def_addrs[j]);
+
+				auto prres = pr.parsePreprocInstruction(text);
+
+				if(prres[0] == PREPROC_BANKSIZE_SIGN)
+					windows.setBankSizeKb(prresNum(prres[1], 0, 0xFF, 1, l));
+				else if(prres[0] == PREPROC_BANKORG_SIGN)
+					windows.setDefaultWindow(prresNum(prres[1], 0, 0xFFFF, 1, l));
+
+				else if(prres[0] == PREPROC_BANK_SIGN)
+				{
+					cur = prresNum(prres[1], 0, 0xFFFF, 1, l);
+
+					if(prres.size() > 2)
+						windows.setWindow(cur, prresNum(prres[2], 0, 0xFFFF, 1, l));
+					else if(!windows.isUsed(cur))
+						windows.setWindow(cur, windows.getDefaultWindow(cur));
+
+					windows.use(cur);
+				}
+
+				else if(prres[0] == PREPROC_TRAMPOLINES_SIGN)
+				{
+					if(tramp_line >= 0)
+						err_show(FARCALL_ERROR, 1, l + " (twice)");
+
+					tramp_line = i;
+					tramp_bank = cur;
+				}
+			}
+		}
+
+		err_file = nullptr;
+
+		fc.setBankSize(windows.getBankSize());
+
+		for(auto b : windows.getUsedBanks())
+			fc.addBank(b, windows.getWindow(b));
+	}
+
+	for(auto& c : calls)
+	{
+		auto& l = insts[c.first];
+		std::string mnemonic = l.text.substr(0, 3);
+		std::string target = l.text.substr(3);
+
+		for(auto& ch : mnemonic)
+			ch = ::toupper(ch);
+
+		target.erase(std::remove_if(target.begin(), target.end(), ::isspace), target.end());
+
+		std::string name = fc.route(mnemonic, target, c.second);
+
+		if(name == "")
+			continue;
+
+		if(tramp_line < 0)
+			*out << "sfotasm: warning: " << *l.file << ":" << l.line << ": " << l.text << " goes into a bank that may be switched out" << std::endl;
+		else
+			l.text = mnemonic + " " + name;
+	}
+
+	if(tramp_line >= 0 && !fc.empty())
+	{
+		locate(insts[tramp_line]);
+
+		if(!fc.isFixed(tramp_bank))
+			err_show(FARCALL_ERROR, 1, insts[tramp_line].text + " (not in a fixed bank)");
+
+		std::vector<std::string> lines;
+
+		if(!fc.setMapper(pr.getMapper()) || !fc.generate(lines))
+			err_show(FARCALL_ERROR, 1, insts[tramp_line].text + " (" + fc.getError() + ")");
+
+		std::vector<source_line> generated;
+
+		for(auto& t : lines)
+			generated.push_back({t, insts[tramp_line].file, insts[tramp_line].line});
+
+		insts.insert(insts.begin() + tramp_line + 1, generated.begin(), generated.end());
+		err_file = nullptr;
+	}
+
+	// the trampolines take space a section may have got: place the sections
+	// again, calls were routed by their banks so those have to stay
+	if(floating && tramp_line >= 0 && !fc.empty())
+	{
+		size_t at = insts.size();
+
+		for(size_t i(floats.size()); i-- > 0;)
+		{
+			at -= float_lines[i].size();
+			float_lines[i].assign(insts.begin() + at, insts.begin() + at + float_lines[i].size());
+			at -= 2;
+		}
+
+		std::vector<size_t> placed_banks;
+
+		for(auto& f : sc.getSections())
+			placed_banks.push_back(f.placed_bank);
+
+		insts.resize(at);
+		sc = sections();
+		placeSections();
+
+		for(size_t i(0); i < floats.size(); i++)
+		{
+			if(sc.getSections()[i].placed_bank == placed_banks[i])
+				continue;
+
+			locate(float_heads[i]);
+			err_show(SECTION_ERROR, 1, float_heads[i].text + " (moves to another bank around the trampolines, give it bank=)");
+		}
+	}
+
+	// PASS 1: some preprocessing, label setting, syntax checking
+
+	bool defaddrs = false;
+
+	std::vector<timed_block> timed_open;
+
+	struct nocross_block
+	{
+		size_t start;
+		bool warn;
+		std::string instruction;
+	};
+
+	std::vector<nocross_block> nocross_open;
+
+	// .incbin and .compress bytes by instruction number, placed in pass 2
+	std::map<size_t, std::string> blobs;
+	std::string compress_method = "";
+	std::string compress_data = "";
+	size_t chr_size = 0;
+	compression cm;
+
+	auto pack = [&](std::string method, std::string& data, std::string instruction)
+	{
+		std::string packed;
+
+		if(!cm.pack(method, data, packed))
+			err_show(COMPRESSION_ERROR, 1, instruction + " (" + cm.getError() + ")");
+
+		// a label right before the data gets label.size and label.packed
+		if(label_names.size() > 0 && label_adrs[label_names.back()] == real_adr)
+		{
+			label_adrs[label_names.back() + ".size"] = data.size();
+			label_adrs[label_names.back() + ".packed"] = packed.size();
+		}
+
+		data = packed;
+	};
+
+	// .pool: every label starts a blob; a blob that equals the end of one
+	// already laid out in the same bank becomes a label into it
+	struct pool_blob
+	{
+		std::string label;
+		size_t line;
+		// instruction number of the first data line
+		size_t instr;
+		size_t address;
+		std::string data;
+		// false when a byte waits for pass 2
+		bool known;
+	};
+
+	struct pool_merge
+	{
+		std::string label;
+		size_t address;
+		size_t size;
+	};
+
+	// .reloc: labels get run addresses, the bytes stay at the load address
+	struct reloc_section
+	{
+		std::string name;
+		size_t load;
+		size_t run;
+		std::string instruction;
+	};
+
+	bool relocating = false;
+	reloc_section reloc;
+
+	bool pooling = false;
+	bool blob_open = false;
+	pool_blob blob;
+	std::map<size_t, std::unordered_map<std::string, size_t>> pooled;
+	// the same blobs in layout order, searched for tails
+	std::map<size_t, std::vector<std::string>> pool_order;
+	std::vector<pool_merge> pool_merges;
+
+	auto poolBytes = [&](const std::vector<std::string>& prres)
+	{
+		for(size_t j(1); j < prres.size(); j++)
+		{
+			if(prres[j][0] == PREPROC_EXPR_PREFIX[0])
+			{
+				blob.known = false;
+				return;
+			}
+
+			for(size_t k(0); k < prres[j].length(); k += 2)
+				blob.data += (char)std::stoi(prres[j].substr(k, 2), 0, 16);
+		}
+	};
+
+	// n is the line after the blob, it moves back when the blob goes
+	auto closeBlob = [&](size_t& n)
+	{
+		if(!blob_open)
+			return;
+
+		blob_open = false;
+
+		if(!blob.known || blob.data.empty())
+			return;
+
+		auto& known = pooled[bank];
+		auto f = known.find(blob.data);
+		size_t size = blob.data.size();
+
+		if(f == known.end())
+		{
+			for(auto& d : pool_order[bank])
+			{
+				if(d.size() > size && d.compare(d.size() - size, size, blob.data) == 0)
+				{
+					f = known.find(d);
+					break;
+				}
+			}
+		}
+
+		if(f == known.end())
+		{
+			known[blob.data] = blob.address;
+			pool_order[bank].push_back(blob.data);
+			return;
+		}
+
+		label_adrs[blob.label] = f->second + f->first.size() - size;
+		pool_merges.push_back({blob.label, label_adrs[blob.label], size});
+
+		insts.erase(insts.begin() + blob.line + 1, insts.begin() + n);
+		blobs.erase(blobs.lower_bound(blob.instr), blobs.end());
+		n = blob.line + 1;
+		instr_num = blob.instr;
+		real_adr = blob.address;
+	};
+
+	size_t loop_bound = 0;
+
+	// listings, .pool (which takes laid out data back) and analysis need both passes
+	bool single = job.single_pass && !job.analyze;
+
+	for(auto& l : insts)
+		if(l.text.compare(0, 5, ".pool") == 0 || l.text.compare(0, 5, ".list") == 0)
+			single = false;
+
+	// output position, in pass 2 or with --single-pass right in pass 1
+	size_t out_bank = 0;
+	size_t position = 0;
+	std::map<size_t, size_t> positions;
+	bool compressing = false;
+
+	bool nowlisting = false;
+	listing lst;
+	bool code_line = false;
+
+	// run address minus load address inside .reloc
+	size_t reloc_delta = 0;
+
+	// every byte goes through here so the listing sees it
+	auto emit = [&](const std::string& hex, const source_line& line)
+	{
+		if(nowlisting)
+			lst.add(prg.getWindow(out_bank) + position + reloc_delta, out_bank, hex, *line.file, line.line, line.text);
+
+		if(job.analyze && hex != "")
+		{
+			auto& c = result.lines[{*line.file, line.line}];
+
+			if(c.hex == "")
+				c = {prg.getWindow(out_bank) + position + reloc_delta, out_bank, "", code_line};
+			c.hex += hex;
+		}
+
+		position += prg.write(out_bank, position, hex);
+	};
+
+	// right after evalOperand, which leaves the names it used in ex
+	auto refer = [&](const source_line& line)
+	{
+		if(nowlisting)
+			for(auto& name : ex.getLastNames())
+				lst.reference(name, *line.file, line.line);
+	};
+
+	// --single-pass: a forward reference is written as zeros and patched when
+	// its label is defined, what is left when pass 1 ends is patched after it
+	struct fixup
+	{
+		size_t bank;
+		size_t position;
+		std::string expr;
+		long lo;
+		long hi;
+		// bytes, 0 for a branch offset from rel_adr
+		int size;
+		size_t rel_adr;
+		source_line line;
+		bool done;
+	};
+
+	std::vector<fixup> fixups;
+	std::unordered_multimap<std::string, size_t> waiting;
+
+	auto encode = [&](const fixup& f, long v)
+	{
+		if(f.size == 0)
+			return makeRelative(v, f.rel_adr, f.line.text);
+
+		if(f.size == 1)
+			return hexNum(v & 0xFF, 2);
+
+		std::string w = hexNum(v & 0xFFFF, 4);
+		return w.substr(2, 2) + w.substr(0, 2);
+	};
+
+	// waits for the first symbol of the last evaluation that isn't defined yet
+	auto wait = [&](size_t f)
+	{
+		for(auto& name : ex.getLastNames())
+		{
+			if(!label_adrs.count(name))
+			{
+				waiting.insert({name, f});
+				return;
+			}
+		}
+	};
+
+	// bytes of expr at offset into the current line's bytes
+	auto operand = [&](const std::string& expr, long lo, long hi, int size, size_t offset, const source_line& line)
+	{
+		fixup f = {out_bank, position + offset, expr, lo, hi, size, rel_adrs[instr_num], line, false};
+		long v;
+
+		if(single && !ex.evaluate(expr, label_adrs, v) && ex.isUndefined())
+		{
+			wait(fixups.size());
+			fixups.push_back(f);
+
+			return std::string(size == 2 ? 4 : 2, '0');
+		}
+
+		return encode(f, evalOperand(expr, label_adrs, lo, hi, 2, line.text));
+	};
+
+	auto backpatch = [&](fixup& f)
+	{
+		locate(f.line);
+		prg.write(f.bank, f.position, encode(f, evalOperand(f.expr, label_adrs, f.lo, f.hi, 2, f.line.text)));
+		f.done = true;
+	};
+
+	auto resolve = [&](const std::string& name)
+	{
+		auto range = waiting.equal_range(name);
+		std::vector<size_t> ready;
+
+		for(auto w = range.first; w != range.second; w++)
+			ready.push_back(w->second);
+
+		waiting.erase(name);
+
+		for(auto f : ready)
+		{
+			long v;
+
+			if(!ex.evaluate(fixups[f].expr, label_adrs, v) && ex.isUndefined())
+				wait(f);
+			else
+				backpatch(fixups[f]);
+		}
+	};
+
+	// the bytes of one line at the output position
+	auto emitLine = [&](const source_line& line, std::vector<std::string>& res)
+	{
+		auto& i = line.text;
+
+		code_line = res[0] != PREPROC_SIGN;
+
+		if(res[0] == PREPROC_SIGN)
+		{
+			auto prres = pr.parsePreprocInstruction(i);
+
+			if(prres[0] == PREPROC_BANK_SIGN)
+			{
+				positions[out_bank] = position;
+				out_bank = std::stoi(prres[1]);
+				position = positions[out_bank];
+			}
+
+			else if(prres[0] == PREPROC_OFFSET_SIGN)
+			{
+				size_t adr = std::stoi(prres[1]);
+				size_t window = prg.getWindow(out_bank);
+
+				if(adr >= window)
+					position = adr - window;
+				else
+					position = adr;
+
+				prg.write(out_bank, position, "");
+			}
+
+			else if(prres[0] == PREPROC_COMPRESS_SIGN)
+			{
+				compressing = true;
+			}
+
+			else if(prres[0] == PREPROC_RELOC_SIGN)
+			{
+				reloc_delta = std::stoi(prres[2]) - (prg.getWindow(out_bank) + position);
+			}
+
+			else if(prres[0] == PREPROC_ENDRELOC_SIGN)
+			{
+				reloc_delta = 0;
+			}
+
+			else if(compressing && (prres[0] == PREPROC_DB_SIGN || prres[0] == PREPROC_DW_SIGN))
+			{
+			}
+
+			else if(prres[0] == PREPROC_INCBIN_SIGN || prres[0] == PREPROC_ENDCOMPRESS_SIGN)
+			{
+				compressing = false;
+
+				// binary data is listed without its bytes
+				if(nowlisting)
+					lst.add(prg.getWindow(out_bank) + position, out_bank, "", *line.file, line.line, i);
+
+				position += prg.writeBytes(out_bank, position, blobs[instr_num]);
+			}
+
+			else if(prres[0] == PREPROC_DB_SIGN)
+			{
+				std::string hex = "";
+
+				for(size_t j(1); j < prres.size(); j++)
+				{
+					if(prres[j][0] == PREPROC_EXPR_PREFIX[0])
+					{
+						prres[j] = operand(prres[j].substr(1), -0x80, 0xFF, 1, hex.length()/2, line);
+						refer(line);
+					}
+
+					hex += prres[j];
+				}
+
+				emit(hex, line);
+			}
+
+			else if(prres[0] == PREPROC_DW_SIGN)
+			{
+				std::string hex = "";
+
+				for(size_t j(1); j < prres.size(); j++)
+				{
+					if(prres[j][0] == PREPROC_EXPR_PREFIX[0])
+					{
+						prres[j] = operand(prres[j].substr(1), -0x8000, 0xFFFF, 2, hex.length()/2, line);
+						refer(line);
+					}
+
+					hex += prres[j];
+				}
+
+				emit(hex, line);
+			}
+
+			else if(prres[0] == PREPROC_ALIGN_SIGN)
+			{
+				size_t n = std::stoi(prres[1]);
+				size_t adr = prg.getWindow(out_bank) + position;
+				std::string fill = "";
+
+				for(size_t k((n - adr % n) % n); k > 0; k--)
+					fill += prres[2];
+
+				// padding is listed without its bytes
+				if(nowlisting)
+					lst.add(adr, out_bank, "", *line.file, line.line, i);
+
+				position += prg.write(out_bank, position, fill);
+			}
+
+			else if(prres[0] == PREPROC_LIST_SIGN && !job.analyze)
+			{
+				if(!lst.isOpen() && !lst.open(job.resfilename+".lst"))
+					err_show(OUTPUT_FILE_ERROR, 2, job.resfilename+".lst");
+
+				nowlisting = true;
+			}
+
+			else if(prres[0] == PREPROC_NOLIST_SIGN)
+			{
+				nowlisting = false;
+			}				
+
+		}
+
+		else if(res[0] == LABEL_CALL_SIGN)
+		{
+			std::string num = operand(res[1], 0, 0xFFFF, 2, 1, line);
+
+			refer(line);
+			emit(res[2] + num, line);
+		}
+
+		else if(res[0] == LABEL_IMM_SIGN || res[0] == LABEL_ZP_SIGN)
+		{
+			long lo = res[0] == LABEL_IMM_SIGN ? -0x80 : 0;
+			std::string hx = operand(res[1], lo, 0xFF, 1, 1, line);
+
+			refer(line);
+			emit(res[2] + hx, line);
+		}
+
+		else if(res[0] == RELATIVE_SIGN || res[0] == RELATIVE_ADDR_SIGN)
+		{
+			std::string rel;
+
+			if(res[0] == RELATIVE_SIGN)
+			{
+				rel = operand(res[1], 0, 0xFFFF, 0, 1, line);
+				refer(line);
+			}
+
+			else
+				rel = makeRelative(std::stoi(res[1], 0, 16), rel_adrs[instr_num], i);
+
+			emit(res[2] + rel, line);
+		}
+
+		else if(res[0] == LABEL_SIGN)
+		{
+			emit("", line);
+		}
+
+		else
+		{
+			emit(get_str(res), line);
+		}
+	};
+
+	err_single = single;
+
+	for(size_t n(0); n < insts.size(); n++)
+	{
+		auto& i = insts[n].text;
+
+		locate(insts[n]);
+
+		if(defaddrs)
+		{
+			for(auto j : def_names)
+			{
+				for(size_t p = i.find(j); p != std::string::npos; p = i.find(j, p))
+				{
+					i.replace(p, j.length(), def_addrs[j]);
+					p += def_addrs[j].length();
+				}
+			}
+		}
+
+		for(auto j : user_def_names)
+		{
+			for(size_t p = i.find(j); p != std::string::npos; p = i.find(j, p))
+			{
+				i.replace(p, j.length(), user_def_addrs[j]);
+				p += user_def_addrs[j].length();
+			}
+		}
+
+		auto res = parse(i);
+
+		shorten(res);
+
+		if(res[0] == COMMENT_SIGN)
+			continue;
+		else if(res[0] == ERROR_ILLEGAL_INSTRUCTION_SIGN)
+			err_show(UNKNOWN_INSTRUCTION, 1, i);
+		else if(res[0] == ERROR_ILLEGAL_OPERAND_SIGN)
+			err_show(ILLEGAL_OPERAND, 1, i);
+
+		if(compress_method != "" && res[0] != PREPROC_SIGN)
+			err_show(COMPRESSION_ERROR, 1, i + " (only .db and .dw go into .compress)");
+
+		if(pooling && res[0] != PREPROC_SIGN && res[0] != LABEL_SIGN)
+			err_show(POOL_ERROR, 1, i + " (only labels and data go into .pool)");
+
+		// .loop annotates the instruction that follows it
+		if(loop_bound && res[0] != PREPROC_SIGN && res[0] != LABEL_SIGN)
+		{
+			tm.addLoopBound(real_adr, loop_bound);
+			loop_bound = 0;
+		}
+
+		if(res[0] == PREPROC_SIGN)
+		{
+			auto prres = pr.parsePreprocInstruction(i);
+
+			if(prres[0] == PREPROC_ERROR)
+				err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, i);
+
+			if(compress_method != "" && prres[0] != PREPROC_DB_SIGN && prres[0] != PREPROC_DW_SIGN &&
+				prres[0] != PREPROC_ENDCOMPRESS_SIGN)
+				err_show(COMPRESSION_ERROR, 1, i + " (only .db and .dw go into .compress)");
+
+			if(pooling && prres[0] != PREPROC_DB_SIGN && prres[0] != PREPROC_DW_SIGN && prres[0] != PREPROC_TABLE_SIGN &&
+				prres[0] != PREPROC_INCBIN_SIGN && prres[0] != PREPROC_COMPRESS_SIGN &&
+				prres[0] != PREPROC_ENDCOMPRESS_SIGN && prres[0] != PREPROC_ENDPOOL_SIGN)
+				err_show(POOL_ERROR, 1, i + " (only labels and data go into .pool)");
+
+			if(compress_method != "" && prres[0] != PREPROC_ENDCOMPRESS_SIGN)
+			{
+				// the data has to be known now to lay out what follows
+				bool word = prres[0] == PREPROC_DW_SIGN;
+
+				for(size_t j(1); j < prres.size(); j++)
+				{
+					long v;
+
+					if(prres[j][0] == PREPROC_EXPR_PREFIX[0])
+						v = evalOperand(prres[j].substr(1), label_adrs, word ? -0x8000 : -0x80, word ? 0xFFFF : 0xFF, 1, i);
+					else
+						v = std::stoi(prres[j].substr(2) + prres[j].substr(0, 2), 0, 16);
+
+					compress_data += (char)(v & 0xFF);
+
+					if(word)
+						compress_data += (char)((v >> 8) & 0xFF);
+				}
+			}
+
+			else if(prres[0] == PREPROC_COMPRESS_SIGN)
+			{
+				compress_method = prres[1];
+				compress_data = "";
+			}
+
+			else if(prres[0] == PREPROC_ENDCOMPRESS_SIGN)
+			{
+				if(compress_method == "")
+					err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, i);
+
+				pack(compress_method, compress_data, i);
+				blobs[instr_num] = compress_data;
+
+				if(blob_open)
+					blob.data += compress_data;
+
+				real_adr += compress_data.size();
+				compress_method = "";
+			}
+
+			else if(prres[0] == PREPROC_INCBIN_SIGN)
+			{
+				std::string data;
+
+				if(!readBinary(prres[1], data))
+					err_show(BIN_FILE_NOT_FOUND, 1, i);
+
+				if(prres[2] != "")
+					pack(prres[2], data, i);
+
+				else
+				{
+					// plain .incbin data is CHR, cut to the size declared by .ines
+					size_t limit = pr.getChrSizeKb()*1024;
+					size_t n = chr_size < limit ? std::min(data.size(), limit - chr_size) : 0;
+
+					data = data.substr(0, n);
+					chr_size += n;
+				}
+
+				blobs[instr_num] = data;
+				real_adr += data.size();
+
+				// CHR data isn't in the bank
+				if(blob_open)
+				{
+					blob.data += data;
+					blob.known = blob.known && prres[2] != "";
+				}
+			}
+
+			else if(prres[0] == PREPROC_POOL_SIGN)
+			{
+				if(pooling)
+					err_show(POOL_ERROR, 1, i + " (already in .pool)");
+
+				pooling = true;
+			}
+
+			else if(prres[0] == PREPROC_ENDPOOL_SIGN)
+			{
+				if(!pooling)
+					err_show(POOL_ERROR, 1, i + " (no .pool)");
+
+				closeBlob(n);
+				pooling = false;
+			}
+
+			else if(prres[0] == PREPROC_TIMED_SIGN)
+			{
+				timed_open.push_back({real_adr, 0, (size_t)prresNum(prres[1], 0, 0x7FFFFFFF, 1, i), i, bank});
+			}
+
+			else if(prres[0] == PREPROC_ENDTIMED_SIGN)
+			{
+				if(timed_open.empty())
+					err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, i);
+
+				timed_open.back().end = real_adr;
+				tm.addBlock(timed_open.back());
+				timed_open.pop_back();
+			}
+
+			else if(prres[0] == PREPROC_ALIGN_SIGN)
+			{
+				size_t n = prresNum(prres[1], 1, 0xFFFF, 1, i);
+				real_adr += (n - real_adr % n) % n;
+			}
+
+			else if(prres[0] == PREPROC_NOCROSS_SIGN)
+			{
+				nocross_open.push_back({real_adr, prres[1] == "1", i});
+			}
+
+			else if(prres[0] == PREPROC_ENDNOCROSS_SIGN)
+			{
+				if(nocross_open.empty())
+					err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, i);
+
+				nocross_block nc = nocross_open.back();
+				nocross_open.pop_back();
+
+				if(real_adr > nc.start && (nc.start >> 8) != ((real_adr-1) >> 8))
+				{
+					std::string msg = nc.instruction + " at $" + hexNum(nc.start, 4) + " ends at $" + hexNum(real_adr-1, 4);
+
+					if(!nc.warn)
+						err_show(PAGE_CROSSED, 1, msg);
+
+					*out << "sfotasm: warning: page crossed: " << msg << std::endl;
+				}
+			}
+
+			else if(prres[0] == PREPROC_LOOP_SIGN)
+			{
+				loop_bound = prresNum(prres[1], 0, 0x7FFFFFFF, 1, i);
+			}
+
+			else if(prres[0] == PREPROC_TABLE_SIGN)
+			{
+				// expand into .db/.dw lines and assemble those instead
+				bool word = prres[1] == "2";
+				auto syms = label_adrs;
+				long from = evalOperand(prres[3], syms, -0xFFFF, 0xFFFF, 1, i);
+				long to = evalOperand(prres[4], syms, -0xFFFF, 0xFFFF, 1, i);
+
+				std::vector<source_line> lines;
+				std::string line = "";
+				int count = 0;
+
+				for(long v(from); v <= to; v++)
+				{
+					syms[prres[2]] = v;
+
+					long val;
+
+					if(!ex.evaluate(prres[5], syms, val))
+						err_show(ILLEGAL_OPERAND, 1, i + " (" + ex.getError() + ")");
+
+					line += (count ? ", $" : "$") + (word ? hexNum(val & 0xFFFF, 4) : hexNum(val & 0xFF, 2));
+
+					if(++count == 16 || v == to)
+					{
+						lines.push_back({(word ? ".dw " : ".db ") + line, insts[n].file, insts[n].line});
+						line = "";
+						count = 0;
+					}
+				}
+
+				insts.erase(insts.begin()+n);
+				insts.insert(insts.begin()+n, lines.begin(), lines.end());
+				n--;
+				continue;
+			}
+
+			else if(prres[0] == PREPROC_USE_ILLOPCODES_SIGN)
+			{
+				inst.addIllegalOpcodes();
+				illegal = true;
+			}
+
+			else if(prres[0] == PREPROC_USE_DEFS_SIGN)
+			{
+				defaddrs = true;
+			}
+
+			else if(prres[0] == PREPROC_DEFINE_SIGN)
+			{
+				if(prres[1][0] != '@')
+					err_show(ILLEGAL_DEFINE, 1, i);
+
+				user_def_names.push_back(prres[1]);
+				user_def_addrs[prres[1]] = prres[2];
+
+				if(job.analyze)
+					result.defines[prres[1]] = {prres[2], insts[n].file, insts[n].line};
+			}
+
+			else if(prres[0] == PREPROC_RELOC_SIGN)
+			{
+				if(relocating)
+					err_show(RELOC_ERROR, 1, i + " (already in .reloc " + reloc.name + ")");
+
+				relocating = true;
+				reloc = {prres[1], real_adr, (size_t)prresNum(prres[2], 0, 0xFFFF, 1, i), i};
+				real_adr = reloc.run;
+
+				label_adrs[reloc.name + ".load"] = reloc.load;
+				label_adrs[reloc.name + ".run"] = reloc.run;
+			}
+
+			else if(prres[0] == PREPROC_ENDRELOC_SIGN)
+			{
+				if(!relocating)
+					err_show(RELOC_ERROR, 1, i + " (no .reloc)");
+
+				size_t size = real_adr - reloc.run;
+
+				label_adrs[reloc.name + ".size"] = size;
+				real_adr = reloc.load + size;
+				relocating = false;
+			}
+
+			else if(prres[0] == PREPROC_ENDSECTION_SIGN)
+			{
+				err_show(SECTION_ERROR, 1, i + " (no .section)");
+			}
+
+			else if(relocating && (prres[0] == PREPROC_OFFSET_SIGN || prres[0] == PREPROC_BANK_SIGN || prres[0] == PREPROC_ALIGN_SIGN))
+			{
+				err_show(RELOC_ERROR, 1, i + " (.org, .bank and .align can't be in .reloc)");
+			}
+
+			else if(prres[0] == PREPROC_OFFSET_SIGN)
+			{
+				size_t adr = prresNum(prres[1], 0, 0xFFFF, 1, i);
+				size_t window = prg.getWindow(bank);
+
+				// addresses below the window are offsets into the bank
+				if(adr >= window + prg.getBankSize() || (adr < window && adr >= prg.getBankSize()))
+					err_show(ORG_ADR_ERROR, 1, i);
+
+				if(adr >= window)
+					real_adr = adr;
+				else
+					real_adr = adr + window;
+			}
+
+			else if(prres[0] == PREPROC_BANK_SIGN)
+			{
+				bank = prresNum(prres[1], 0, 0xFFFF, 1, i);
+
+				if(prres.size() > 2)
+					prg.setWindow(bank, prresNum(prres[2], 0, 0xFFFF, 1, i));
+				else if(!prg.isUsed(bank))
+					prg.setWindow(bank, prg.getDefaultWindow(bank));
+
+				prg.use(bank);
+				real_adr = prg.getWindow(bank);
+			}
+
+			else if(prres[0] == PREPROC_BANKSIZE_SIGN)
+			{
+				if(!prg.setBankSizeKb(prresNum(prres[1], 0, 0xFF, 1, i)))
+					err_show(BANK_GEOMETRY_ERROR, 1, i);
+			}
+
+			else if(prres[0] == PREPROC_BANKORG_SIGN)
+			{
+				prg.setDefaultWindow(prresNum(prres[1], 0, 0xFFFF, 1, i));
+			}
+
+			else if(prres[0] == PREPROC_RSSET_SIGN)
+			{
+				rsset = prresNum(prres[1], 0, 0xFFFF, 1, i);
+			}
+
+			else if(prres[0] == PREPROC_RS_SIGN)
+			{
+				std::string rs_name = prres[1];
+				size_t bytes = prresNum(prres[2], 0, 0xFFFF, 1, i);
+
+				label_names.push_back(rs_name);
+				label_lines[rs_name] = insts[n];
+				rs_names.push_back(rs_name);
+				label_adrs[rs_name] = rsset;
+				rsset += bytes;
+			}
+
+			else if(prres[0] == PREPROC_VAR_SIGN)
+			{
+				label_names.push_back(prres[1]);
+				label_lines[prres[1]] = insts[n];
+				rs_names.push_back(prres[1]);
+				label_adrs[prres[1]] = var_adrs[prres[1]];
+			}
+
+			else if(prres[0] == PREPROC_DB_SIGN)
+			{
+				real_adr += prres.size()-1;
+
+				if(blob_open)
+					poolBytes(prres);
+			}
+
+			else if(prres[0] == PREPROC_DW_SIGN)
+			{
+				real_adr += 2*(prres.size()-1);
+
+				if(blob_open)
+					poolBytes(prres);
+			}
+		}
+
+		else if(res[0] == LABEL_SIGN)
+		{
+			if(pooling)
+				closeBlob(n);
+
+			if(label_lines.count(res[1]))
+			{
+				auto& first = label_lines[res[1]];
+				std::string at = first.file ? *first.file + ":" + std::to_string(first.line) : "generated code";
+
+				err_show(LABEL_REDEFINED, 1, i + " (first at " + at + ")");
+			}
+
+			label_names.push_back(res[1]);
+			label_adrs[res[1]] = real_adr;
+			label_lines[res[1]] = insts[n];
+			label_banks[res[1]] = bank;
+
+			if(single)
+			{
+				resolve(res[1]);
+				locate(insts[n]);
+			}
+
+			if(pooling)
+			{
+				blob = {res[1], n, instr_num+1, real_adr, "", true};
+				blob_open = true;
+			}
+		}
+
+		else if(res[0] == RELATIVE_SIGN)
+		{
+			real_adr += 2;
+			rel_adrs[instr_num] = real_adr;
+		}
+
+		else if(res[0] == RELATIVE_ADDR_SIGN)
+		{
+			real_adr += 2;
+			rel_adrs[instr_num] = real_adr;
+		}
+
+		else if(res[0] == LABEL_IMM_SIGN || res[0] == LABEL_ZP_SIGN)
+		{
+			real_adr += 2;
+		}
+
+		else
+		{
+			real_adr += res.size();
+		}
+
+		if(single)
+			emitLine(insts[n], res);
+
+		instr_num++;
+	}
+
+	err_file = nullptr;
+
+	if(job.analyze)
+		for(auto& l : label_lines)
+			result.symbols[l.first] = {label_adrs[l.first], l.second.file, l.second.line};
+
+	if(!timed_open.empty())
+		err_show(UNBOUNDED_TIMING, 1, timed_open.back().instruction + " (no .endtimed)");
+
+	if(compress_method != "")
+		err_show(COMPRESSION_ERROR, 1, ".compress " + compress_method + " (no .endcompress)");
+
+	if(!nocross_open.empty())
+		err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, nocross_open.back().instruction + " (no .endnocross)");
+
+	if(pooling)
+		err_show(POOL_ERROR, 1, ".pool (no .endpool)");
+
+	if(relocating)
+		err_show(RELOC_ERROR, 1, reloc.instruction + " (no .endreloc)");
+
+	// symbols defined after their uses, .reloc sizes and the like
+	for(auto& f : fixups)
+		if(!f.done)
+			backpatch(f);
+
+	err_single = false;
+
+
+	// PASS 2: syntax checking, prog making
+
+	if(!single)
+	{
+		instr_num = 0;
+
+		for(auto& line : insts)
+		{
+			auto res = parse(line.text);
+
+			shorten(res);
+			locate(line);
+			emitLine(line, res);
+			instr_num++;
+		}
+	}
+
+	err_file = nullptr;
+
+	// static cycle budgets of .timed blocks
+
+	auto timed = tm.getBlocks();
+
+	for(auto i : prg.getUsedBanks())
+		tm.addBank(i, prg.getWindow(i), prg.getBank(i));
+
+	for(size_t i(0); i < timed.size(); i++)
+	{
+		long worst = tm.worstCase(i);
+
+		if(worst < 0)
+			err_show(UNBOUNDED_TIMING, 2, timed[i].instruction + " (" + tm.getError() + ")");
+
+		bool over = (size_t)worst > timed[i].max_cycles;
+
+		// a build within budget only reports it along with a listing
+		if(over || lst.isOpen())
+		{
+			*out << "sfotasm: " << timed[i].instruction << " at $" << hexNum(timed[i].start, 4);
+			*out << ": worst case " << worst << " cycles" << std::endl;
+		}
+
+		if(over)
+			err_show(CYCLE_BUDGET_EXCEEDED, 2, timed[i].instruction);
+	}
+
+	if(job.analyze)
+		return;
+
+	if(job.patch_against == "")
+	{
+		if(!prg.writeFile(job.resfilename, pr.makeHeader()))
+			err_show(OUTPUT_FILE_ERROR, 2, job.resfilename);
+	}
+
+	else
+	{
+		std::string image = prg.makeImage(pr.makeHeader());
+		std::string old, diff, current;
+		patch pt;
+
+		if(!readBinary(job.patch_against, old))
+			err_show(INPUT_FILE_NOT_FOUND, 2, job.patch_against);
+
+		if(!pt.make(job.patch_format, old, image, diff))
+			err_show(PATCH_ERROR, 2, job.patch_against + " (" + pt.getError() + ")");
+
+		std::ofstream output(job.resfilename + "." + job.patch_format, std::ios::binary);
+		output.write(diff.data(), diff.size());
+
+		if(!output.good())
+			err_show(OUTPUT_FILE_ERROR, 2, job.resfilename + "." + job.patch_format);
+
+		// an unchanged ROM keeps its file time for the tools that copy it; the
+		// output isn't cached since it changes under the cache
+		if(!job.patch_only && (!source_cache::readBinary(job.resfilename, current) || current != image))
+		{
+			std::ofstream rom_file(job.resfilename, std::ios::binary);
+			rom_file.write(image.data(), image.size());
+
+			if(!rom_file.good())
+				err_show(OUTPUT_FILE_ERROR, 2, job.resfilename);
+		}
+	}
+
+	if(job.depfile)
+		writeDependencies(job);
+
+	if(!vars.empty())
+		writeReport(vars.makeReport(), job.resfilename+".vars");
+
+	if(job.dce)
+		writeReport(dc.makeReport(), job.resfilename+".dce");
+
+	if(tramp_line >= 0 && !fc.empty())
+		writeReport(fc.makeReport(), job.resfilename+".far");
+
+	if(floating)
+		writeReport(sc.makeMap(), job.resfilename+".map");
+
+	if(!pool_merges.empty())
+	{
+		std::stringstream r;
+		size_t saved = 0;
+
+		for(auto& m : pool_merges)
+			saved += m.size;
+
+		r << "; sfotasm pool\n";
+		r << "; saved " << saved << " bytes\n";
+		r << std::left << std::setw(32) << "name" << std::setw(9) << "address" << "size\n";
+
+		for(auto& m : pool_merges)
+			r << std::setw(32) << m.label << std::setw(9) << ("$" + hexNum(m.address, 4)) << m.size << "\n";
+
+		writeReport(r.str(), job.resfilename+".pool");
+	}
+
+	if(job.symbols)
+	{
+		std::ofstream sym(job.resfilename+".sym");
+
+		if(!sym.good())
+			err_show(OUTPUT_FILE_ERROR, 2, job.resfilename+".sym");
+
+		sym << "banksize $" << hexNum(prg.getBankSize(), 4) << "\n";
+
+		for(auto b : prg.getUsedBanks())
+			sym << "bank " << b << " $" << hexNum(prg.getWindow(b), 4) << "\n";
+
+		// .rs variables are RAM, in no bank
+		for(auto& l : label_lines)
+		{
+			auto b = label_banks.find(l.first);
+
+			sym << "sym " << (b == label_banks.end() ? "-" : std::to_string(b->second));
+			sym << " $" << hexNum(label_adrs[l.first], 4) << " " << l.first << "\n";
+		}
+	}
+
+	if(lst.isOpen())
+	{
+		for(auto& l : label_lines)
+			lst.define(l.first, label_adrs[l.first], *l.second.file, l.second.line);
+
+		lst.close();
+	}
+
+	if(job.profiling)
+	{
+		// a plain --profile-entry runs until the routine returns
+		if(!job.profile_frames && !job.profile_cycles && job.entry_label == "")
+			job.profile_frames = 60;
+
+		emulator emu;
+		std::map<std::string, size_t> code_labels;
+
+		auto used = prg.getUsedBanks();
+
+		// banks sharing a window: the lowest one is mapped
+		for(auto i = used.rbegin(); i != used.rend(); i++)
+			emu.loadBank(prg.getBank(*i), prg.getWindow(*i));
+
+		for(auto i : label_names)
+			if(std::find(rs_names.begin(), rs_names.end(), i) == rs_names.end())
+				code_labels[i] = label_adrs[i];
+
+		// the run starts at the entry, so it has to be code
+		if(job.entry_label != "" && !code_labels.count(job.entry_label))
+		{
+			bool known = label_adrs.find(job.entry_label) != label_adrs.end();
+			err_show(UNDEFINED_ENTRY, 3, job.entry_label + (known ? "" : " (undefined)"));
+		}
+
+		emu.setLabels(code_labels);
+		emu.run(job.entry_label, job.profile_frames, job.profile_cycles);
+
+		writeReport(emu.makeReport(), job.resfilename+".prof");
+	}
+}
@@ -0,0 +1,241 @@
+#pragma once
+
+#include "preproc.hpp"
+#include "emulator.hpp"
+#include "timing.hpp"
+#include "macros.hpp"
+#include "rom.hpp"
+#include "listing.hpp"
+#include "variables.hpp"
+#include "deadcode.hpp"
+#include "farcalls.hpp"
+#include "sections.hpp"
+#include "patch.hpp"
+#include "prefetch.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <unordered_map>
+
+enum PASS_ERROR
+{
+	UNKNOWN_INSTRUCTION,
+	ILLEGAL_ADR_TYPE,
+	ORG_ADR_ERROR,
+	TOO_FAR_JMP,
+	UNKNOWN_PREPROC_INSTRUCTION,
+	ILLEGAL_OPERAND,
+	UNDEFINED_LABEL,
+	ILLEGAL_DEFINE,
+	BIN_FILE_NOT_FOUND,
+	INPUT_FILE_NOT_FOUND,
+	OUTPUT_FILE_ERROR,
+	UNDEFINED_ENTRY,
+	CYCLE_BUDGET_EXCEEDED,
+	UNBOUNDED_TIMING,
+	OPERAND_OUT_OF_RANGE,
+	MACRO_ERROR,
+	BANK_GEOMETRY_ERROR,
+	LABEL_REDEFINED,
+	PAGE_CROSSED,
+	COMPRESSION_ERROR,
+	CONDITION_ERROR,
+	VARIABLE_ERROR,
+	POOL_ERROR,
+	FARCALL_ERROR,
+	RELOC_ERROR,
+	SECTION_ERROR,
+	PATCH_ERROR
+};
+
+const size_t ANALYSIS_PARSE_CACHE_SIZE = 200000;
+// lines a source_cache keeps parsed for batch and variant jobs
+const size_t SHARED_PARSE_CACHE_SIZE = 200000;
+
+struct assemble_job
+{
+	std::string filename = "asm.asm";
+	std::string resfilename = "result.nes";
+
+	// NAME or NAME=VALUE, used as .define @NAME VALUE (default 1)
+	std::vector<std::string> defines;
+
+	// -MD: make rule for the output with every file it was built from,
+	// written to depfilename (-MF) or the output name with a .d extension,
+	// -MP adds an empty rule per file
+	bool depfile = false;
+	std::string depfilename = "";
+	bool phony_deps = false;
+
+	// output.sym with the bank windows, labels and .rs variables for --disasm
+	bool symbols = false;
+
+	// check the source and collect getAnalysis() without writing any file,
+	// the assembler keeps the parsed lines for the next analysis run
+	bool analyze = false;
+
+	// profile (.prof) whose instruction counts weight .var references
+	std::string var_profile = "";
+
+	// drop label blocks that nothing reachable from the vectors, .export or
+	// code outside labels refers to, listed in output.dce
+	bool dce = false;
+
+	// patch from this ROM to the output in patch_format (ips or bps), written
+	// to output.ips/.bps; the output itself is only written when it changed,
+	// or not at all with patch_only
+	std::string patch_against = "";
+	std::string patch_format = "ips";
+	bool patch_only = false;
+
+	// write the bytes in pass 1 and patch forward references once their
+	// labels are known instead of walking the source a second time
+	bool single_pass = false;
+
+	// threads reading .include and .incbin files ahead through the
+	// source_cache, 0 reads each file when the assembler gets to it
+	size_t prefetch_threads = PREFETCH_THREADS;
+
+	bool profiling = false;
+	size_t profile_frames = 0;
+	size_t profile_cycles = 0;
+	std::string entry_label = "";
+};
+
+struct source_line
+{
+	std::string text;
+	std::shared_ptr<const std::string> file;
+	size_t line;
+	// macro invocations this line came out of
+	size_t macro_depth = 0;
+};
+
+// symbols and bytes of an analysis run (assemble_job::analyze), for --lsp
+struct analysis
+{
+	struct symbol
+	{
+		size_t address;
+		std::shared_ptr<const std::string> file;
+		size_t line;
+	};
+
+	struct define
+	{
+		std::string value;
+		// nullptr for -D defines
+		std::shared_ptr<const std::string> file;
+		size_t line;
+	};
+
+	struct code
+	{
+		size_t address;
+		size_t bank;
+		std::string hex;
+		bool instruction;
+	};
+
+	// labels and .rs variables
+	std::map<std::string, symbol> symbols;
+	std::map<std::string, define> defines;
+	// by file and line, macro and .table lines count for their invocation
+	std::map<std::pair<std::string, size_t>, code> lines;
+
+	// sources and binaries the run read
+	std::vector<std::string> files;
+
+	bool failed = false;
+	std::string error;
+	// nullptr when the error has no line
+	std::shared_ptr<const std::string> error_file;
+	size_t error_line = 0;
+};
+
+// sources and binaries read once and shared by all assemblers of a batch
+class source_cache
+{
+public:
+	// nullptr when the file can't be read
+	std::shared_ptr<const std::vector<source_line>> getSource(std::string filename);
+	std::shared_ptr<const std::string> getBinary(std::string filename);
+
+	// replaces the file with text (an editor buffer) until forget()
+	void setSource(std::string filename, const std::string& text);
+	// reads the file again the next time
+	void forget(std::string filename);
+
+	// parseInstruction() results shared by the jobs, without and with illegal
+	// opcodes; false when text wasn't parsed yet
+	bool getParsed(const std::string& text, bool illegal, std::vector<std::string>& res);
+	void setParsed(const std::string& text, bool illegal, const std::vector<std::string>& res);
+
+	// source lines without comments and indentation
+	static bool readSource(std::string filename, std::vector<source_line>& strs);
+	static void readSource(std::istream& input, std::string filename, std::vector<source_line>& strs);
+	static bool readBinary(std::string filename, std::string& data);
+private:
+	std::mutex m;
+	// files being read, whoever wants one of them waits for read
+	std::set<std::string> reading;
+	std::condition_variable read;
+	std::map<std::string, std::shared_ptr<const std::vector<source_line>>> sources;
+	std::map<std::string, std::shared_ptr<const std::string>> binaries;
+	std::unordered_map<std::string, std::vector<std::string>> parsed[2];
+};
+
+class assembler
+{
+public:
+	// messages go to out, files are read through cache when there is one
+	assembler(std::ostream& out, source_cache* cache = nullptr);
+
+	// false when the job failed, the error is already written to out
+	bool assemble(assemble_job job);
+
+	const analysis& getAnalysis();
+private:
+	std::ostream* out;
+	source_cache* cache;
+	expressions ex;
+
+	std::map<std::string, std::string> def_addrs;
+	std::vector<std::string> def_names;
+
+	// sources and binaries read by the current job, in order
+	std::vector<std::string> deps;
+
+	analysis result;
+	// location for err_show
+	std::shared_ptr<const std::string> err_file;
+	size_t err_line = 0;
+	// pass 1 and 2 errors come from the one pass of --single-pass
+	bool err_single = false;
+
+	// parseInstruction() results of analysis runs by line, without and with
+	// illegal opcodes
+	std::unordered_map<std::string, std::vector<std::string>> parsed[2];
+
+	void initDefs();
+	void passes(assemble_job& job);
+
+	// prints the error and abandons the job
+	void err_show(PASS_ERROR err, int passnum, std::string instruction);
+
+	long evalOperand(std::string expr, std::map<std::string, size_t>& labels,
+		long lo, long hi, int passnum, std::string instruction);
+	std::string makeRelative(long target, size_t from, std::string instruction);
+	// a number the preproc put in a directive's result, checked against lo..hi
+	long prresNum(const std::string& w, long lo, long hi, int passnum, std::string instruction);
+
+	std::vector<source_line> makeVectorFromFile(std::string filename);
+	bool readBinary(std::string filename, std::string& data);
+	void addDependency(std::string filename);
+	void writeDependencies(assemble_job& job);
+};
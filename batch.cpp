@@ -0,0 +1,157 @@
+#include "batch.hpp"
+
+#include <thread>
+
+bool batch::readManifest(std::string filename, assemble_job base)
+{
+	std::ifstream input(filename);
+
+	if(!input.good())
+	{
+		error = "manifest " + filename + " not found";
+		return false;
+	}
+
+	size_t line_num = 0;
+
+	for(std::string line; std::getline(input, line);)
+	{
+		line_num++;
+
+		std::istringstream words(line);
+		std::string word;
+		std::vector<std::string> args;
+
+		while(words >> word && word[0] != ';' && word[0] != '#')
+			args.push_back(word);
+
+		if(args.empty())
+			continue;
+
+		assemble_job job = base;
+
+		for(size_t i(0); i < args.size(); i++)
+		{
+			if(args[i].compare(0, 2, "-D") == 0 && args[i].length() > 2)
+				job.defines.push_back(args[i].substr(2));
+
+			else if(i == 0)
+				job.filename = args[i];
+
+			else if(i == 1)
+				job.resfilename = args[i];
+
+			else
+			{
+				error = filename + ":" + std::to_string(line_num) + ": unexpected " + args[i];
+				return false;
+			}
+		}
+
+		if(args.size() < 2 || args[1].compare(0, 2, "-D") == 0)
+		{
+			error = filename + ":" + std::to_string(line_num) + ": no output file";
+			return false;
+		}
+
+		jobs.push_back(job);
+	}
+
+	return true;
+}
+
+void batch::addJob(assemble_job job)
+{
+	jobs.push_back(job);
+}
+
+size_t batch::run(size_t threads)
+{
+	if(threads == 0)
+		threads = 1;
+	if(threads > jobs.size())
+		threads = std::max<size_t>(jobs.size(), 1);
+
+	queues.clear();
+
+	for(size_t i(0); i < threads; i++)
+		queues.push_back(std::unique_ptr<job_queue>(new job_queue));
+
+	for(size_t i(0); i < jobs.size(); i++)
+		queues[i % threads]->jobs.push_back(i);
+
+	failed = 0;
+
+	std::vector<std::thread> workers;
+
+	for(size_t i(1); i < threads; i++)
+		workers.push_back(std::thread(&batch::work, this, i));
+
+	work(0);
+
+	for(auto& w : workers)
+		w.join();
+
+	return failed;
+}
+
+size_t batch::getJobCount()
+{
+	return jobs.size();
+}
+
+std::string batch::getError()
+{
+	return error;
+}
+
+bool batch::take(size_t self, size_t& job)
+{
+	for(size_t i(0); i < queues.size(); i++)
+	{
+		job_queue& q = *queues[(self + i) % queues.size()];
+		std::lock_guard<std::mutex> lock(q.m);
+
+		if(q.jobs.empty())
+			continue;
+
+		if(i == 0)
+		{
+			job = q.jobs.front();
+			q.jobs.pop_front();
+		}
+
+		else
+		{
+			job = q.jobs.back();
+			q.jobs.pop_back();
+		}
+
+		return true;
+	}
+
+	// nothing is queued after the start, so empty queues stay empty
+	return false;
+}
+
+void batch::work(size_t self)
+{
+	size_t job;
+
+	while(take(self, job))
+	{
+		std::stringstream log;
+		assembler as(log, &cache);
+
+		if(!as.assemble(jobs[job]))
+			failed++;
+
+		std::string msg = log.str();
+
+		if(msg != "")
+		{
+			std::lock_guard<std::mutex> lock(out_mutex);
+			std::cout << "sfotasm: " << jobs[job].filename << " -> " << jobs[job].resfilename << ":" << std::endl << msg << std::flush;
+		}
+	}
+}
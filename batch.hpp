@@ -0,0 +1,40 @@
+#pragma once
+
+#include "assembler.hpp"
+
+#include <atomic>
+#include <deque>
+
+// many assemble jobs in one process on a work-stealing thread pool, the jobs
+// share the opcode table and the source_cache
+class batch
+{
+public:
+	// lines: input output [-DNAME[=VALUE] ...], options of base apply to every job
+	bool readManifest(std::string filename, assemble_job base);
+	void addJob(assemble_job job);
+
+	// number of failed jobs
+	size_t run(size_t threads);
+
+	size_t getJobCount();
+	std::string getError();
+private:
+	struct job_queue
+	{
+		std::mutex m;
+		std::deque<size_t> jobs;
+	};
+
+	std::vector<assemble_job> jobs;
+	std::vector<std::unique_ptr<job_queue>> queues;
+
+	source_cache cache;
+	std::mutex out_mutex;
+	std::atomic<size_t> failed;
+	std::string error;
+
+	// own queue from the front, the others from the back
+	bool take(size_t self, size_t& job);
+	void work(size_t self);
+};
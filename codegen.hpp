@@ -0,0 +1,365 @@
+#pragma once
+
+// Header only C++20 API to assemble 6502 code from C++ without going through
+// source text, at compile time into a std::array or at run time into a vector:
+//
+//	constexpr auto wait = sfot::assemble<0xC000, [](sfot::code& c)
+//	{
+//		auto loop = c.here();
+//		c.add(sfot::lda(sfot::abs_(0x2002)), sfot::bpl(loop), sfot::rts());
+//	}>();
+//
+// An addressing mode the instruction doesn't have doesn't compile. Undefined
+// labels, branches out of range and operands too large for their mode throw,
+// which stops a constant evaluation.
+// Only legal opcodes, from the table of the assembler. and_ and abs_ have the
+// underscore to stay clear of the keyword and of abs()
+
+#include "optable.hpp"
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+namespace sfot
+{
+
+enum class mode
+{
+	implied,
+	indx,
+	indy,
+	abs,
+	absx,
+	imm,
+	absy,
+	zp,
+	zpx,
+	zpy,
+	ind,
+	// a bare label: relative for branches, absolute for JMP and JSR
+	target
+};
+
+struct label
+{
+	int id;
+};
+
+namespace detail
+{
+
+// operand values that don't fit throw like unbound labels do
+constexpr uint8_t byte(long v, long lo = 0)
+{
+	if(v < lo || v > 0xFF)
+		throw std::out_of_range("operand out of byte range");
+
+	return (uint8_t)v;
+}
+
+constexpr uint16_t word(long v)
+{
+	if(v < 0 || v > 0xFFFF)
+		throw std::out_of_range("address out of range");
+
+	return (uint16_t)v;
+}
+
+}
+
+// an address or a label, the label is resolved when the code is finished
+struct address
+{
+	uint16_t value;
+	int label;
+
+	constexpr address(long v) : value(detail::word(v)), label(-1) {}
+	constexpr address(sfot::label l) : value(0), label(l.id) {}
+};
+
+// immediates may be negative down to -128, the rest are zero page addresses
+struct imm { static constexpr mode kind = mode::imm; uint8_t value; constexpr imm(long v) : value(detail::byte(v, -0x80)) {} };
+struct zp { static constexpr mode kind = mode::zp; uint8_t value; constexpr zp(long v) : value(detail::byte(v)) {} };
+struct zp_x { static constexpr mode kind = mode::zpx; uint8_t value; constexpr zp_x(long v) : value(detail::byte(v)) {} };
+struct zp_y { static constexpr mode kind = mode::zpy; uint8_t value; constexpr zp_y(long v) : value(detail::byte(v)) {} };
+struct ind_x { static constexpr mode kind = mode::indx; uint8_t value; constexpr ind_x(long v) : value(detail::byte(v)) {} };
+struct ind_y { static constexpr mode kind = mode::indy; uint8_t value; constexpr ind_y(long v) : value(detail::byte(v)) {} };
+
+struct abs_ { static constexpr mode kind = mode::abs; address value; constexpr abs_(address a) : value(a) {} };
+struct abs_x { static constexpr mode kind = mode::absx; address value; constexpr abs_x(address a) : value(a) {} };
+struct abs_y { static constexpr mode kind = mode::absy; address value; constexpr abs_y(address a) : value(a) {} };
+struct ind { static constexpr mode kind = mode::ind; address value; constexpr ind(address a) : value(a) {} };
+
+namespace detail
+{
+
+constexpr bool same(const char* a, const char* b)
+{
+	while(*a && *a == *b)
+	{
+		a++;
+		b++;
+	}
+
+	return *a == *b;
+}
+
+constexpr int row(const char* name)
+{
+	for(size_t i(0); i < sizeof(LEGAL_OPCODES)/sizeof(opcode_row); i++)
+		if(same(LEGAL_OPCODES[i].name, name))
+			return i;
+
+	return -1;
+}
+
+constexpr bool isBranch(int r)
+{
+	const char* b = LEGAL_OPCODES[r].name;
+
+	return b[0] == 'B' && !same(b, "BIT") && !same(b, "BRK");
+}
+
+// table column of mode for the mnemonic in row r, -1 when it has none
+constexpr int column(int r, mode m)
+{
+	bool jmp = same(LEGAL_OPCODES[r].name, "JMP");
+	bool zpy_in_zpx = same(LEGAL_OPCODES[r].name, "LDX") || same(LEGAL_OPCODES[r].name, "STX");
+	int c = -1;
+
+	switch(m)
+	{
+		case mode::implied: c = isBranch(r) || jmp ? -1 : 0; break;
+		case mode::target: c = isBranch(r) ? 0 : 3; break;
+		case mode::ind: c = jmp ? 0 : -1; break;
+		case mode::indx: c = 1; break;
+		case mode::indy: c = 2; break;
+		case mode::abs: c = 3; break;
+		case mode::absx: c = 4; break;
+		case mode::imm: c = 5; break;
+		case mode::absy: c = 6; break;
+		case mode::zp: c = 7; break;
+		case mode::zpx: c = zpy_in_zpx ? -1 : 8; break;
+		case mode::zpy: c = zpy_in_zpx ? 8 : -1; break;
+	}
+
+	return c >= 0 && LEGAL_OPCODES[r].codes[c] >= 0 ? c : -1;
+}
+
+template<class Op>
+constexpr mode kindOf()
+{
+	if constexpr(requires { Op::kind; })
+		return Op::kind;
+	else
+		return mode::target;
+}
+
+}
+
+struct instruction
+{
+	uint8_t opcode;
+	uint8_t size;
+	uint16_t value;
+	int label;
+	bool relative;
+};
+
+template<int Row, class... Op>
+concept operands_for = Row >= 0 && sizeof...(Op) <= 1 &&
+	(sizeof...(Op) > 0 || detail::column(Row, mode::implied) >= 0) && ((detail::column(Row, detail::kindOf<Op>()) >= 0) && ...);
+
+template<int Row>
+constexpr instruction make()
+{
+	return {(uint8_t)LEGAL_OPCODES[Row].codes[0], 1, 0, -1, false};
+}
+
+template<int Row, class Op>
+constexpr instruction make(Op op)
+{
+	constexpr int c = detail::column(Row, detail::kindOf<Op>());
+	uint8_t opcode = (uint8_t)LEGAL_OPCODES[Row].codes[c];
+
+	if constexpr(std::is_same_v<Op, label>)
+	{
+		if(c == 0)
+			return {opcode, 2, 0, op.id, true};
+
+		return {opcode, 3, 0, op.id, false};
+	}
+
+	else if constexpr(std::is_same_v<decltype(op.value), address>)
+		return {opcode, 3, op.value.value, op.value.label, false};
+	else
+		return {opcode, 2, op.value, -1, false};
+}
+
+#define SFOT_MNEMONIC(fn, name) \
+	template<class... Op> requires operands_for<detail::row(name), Op...> \
+	constexpr instruction fn(Op... op) { return make<detail::row(name)>(op...); }
+
+SFOT_MNEMONIC(adc, "ADC") SFOT_MNEMONIC(and_, "AND") SFOT_MNEMONIC(asl, "ASL") SFOT_MNEMONIC(bcc, "BCC")
+SFOT_MNEMONIC(bcs, "BCS") SFOT_MNEMONIC(beq, "BEQ") SFOT_MNEMONIC(bit, "BIT") SFOT_MNEMONIC(bmi, "BMI")
+SFOT_MNEMONIC(bne, "BNE") SFOT_MNEMONIC(bpl, "BPL") SFOT_MNEMONIC(brk, "BRK") SFOT_MNEMONIC(bvc, "BVC")
+SFOT_MNEMONIC(bvs, "BVS") SFOT_MNEMONIC(clc, "CLC") SFOT_MNEMONIC(cld, "CLD") SFOT_MNEMONIC(cli, "CLI")
+SFOT_MNEMONIC(clv, "CLV") SFOT_MNEMONIC(cmp, "CMP") SFOT_MNEMONIC(cpx, "CPX") SFOT_MNEMONIC(cpy, "CPY")
+SFOT_MNEMONIC(dec, "DEC") SFOT_MNEMONIC(dex, "DEX") SFOT_MNEMONIC(dey, "DEY") SFOT_MNEMONIC(eor, "EOR")
+SFOT_MNEMONIC(inc, "INC") SFOT_MNEMONIC(inx, "INX") SFOT_MNEMONIC(iny, "INY") SFOT_MNEMONIC(jmp, "JMP")
+SFOT_MNEMONIC(jsr, "JSR") SFOT_MNEMONIC(lda, "LDA") SFOT_MNEMONIC(ldx, "LDX") SFOT_MNEMONIC(ldy, "LDY")
+SFOT_MNEMONIC(lsr, "LSR") SFOT_MNEMONIC(nop, "NOP") SFOT_MNEMONIC(ora, "ORA") SFOT_MNEMONIC(pha, "PHA")
+SFOT_MNEMONIC(php, "PHP") SFOT_MNEMONIC(pla, "PLA") SFOT_MNEMONIC(plp, "PLP") SFOT_MNEMONIC(rol, "ROL")
+SFOT_MNEMONIC(ror, "ROR") SFOT_MNEMONIC(rti, "RTI") SFOT_MNEMONIC(rts, "RTS") SFOT_MNEMONIC(sbc, "SBC")
+SFOT_MNEMONIC(sec, "SEC") SFOT_MNEMONIC(sed, "SED") SFOT_MNEMONIC(sei, "SEI") SFOT_MNEMONIC(sta, "STA")
+SFOT_MNEMONIC(stx, "STX") SFOT_MNEMONIC(sty, "STY") SFOT_MNEMONIC(tax, "TAX") SFOT_MNEMONIC(tay, "TAY")
+SFOT_MNEMONIC(tsx, "TSX") SFOT_MNEMONIC(txa, "TXA") SFOT_MNEMONIC(txs, "TXS") SFOT_MNEMONIC(tya, "TYA")
+
+#undef SFOT_MNEMONIC
+
+// instructions and data from origin on, labels are patched in by bytes()
+class code
+{
+public:
+	constexpr explicit code(uint16_t origin = 0) : origin(origin) {}
+
+	constexpr label makeLabel()
+	{
+		labels.push_back(-1);
+		return {(int)labels.size() - 1};
+	}
+
+	constexpr void bind(label l)
+	{
+		if(labels.at(l.id) >= 0)
+			throw std::logic_error("label bound twice");
+
+		labels[l.id] = pc();
+	}
+
+	// a label at the current address
+	constexpr label here()
+	{
+		label l = makeLabel();
+		bind(l);
+		return l;
+	}
+
+	template<class... I>
+	constexpr code& add(I... i)
+	{
+		(put(i), ...);
+		return *this;
+	}
+
+	template<class... B>
+	constexpr code& db(B... b)
+	{
+		(out.push_back((uint8_t)b), ...);
+		return *this;
+	}
+
+	template<class... W>
+	constexpr code& dw(W... w)
+	{
+		((out.push_back((uint8_t)(w & 0xFF)), out.push_back((uint8_t)((w >> 8) & 0xFF))), ...);
+		return *this;
+	}
+
+	constexpr uint16_t pc() const
+	{
+		return (uint16_t)(origin + out.size());
+	}
+
+	constexpr size_t size() const
+	{
+		return out.size();
+	}
+
+	constexpr std::vector<uint8_t> bytes() const
+	{
+		std::vector<uint8_t> b = out;
+
+		for(auto& f : fixups)
+		{
+			long target = labels.at(f.label);
+
+			if(target < 0)
+				throw std::logic_error("label used but never bound");
+
+			if(f.relative)
+			{
+				long distance = target - (origin + (long)f.at + 1);
+
+				if(distance < -128 || distance > 127)
+					throw std::out_of_range("branch out of range");
+
+				b[f.at] = (uint8_t)(distance & 0xFF);
+			}
+
+			else
+			{
+				target += f.value;
+				b[f.at] = (uint8_t)(target & 0xFF);
+				b[f.at+1] = (uint8_t)((target >> 8) & 0xFF);
+			}
+		}
+
+		return b;
+	}
+private:
+	struct fixup
+	{
+		size_t at;
+		int label;
+		uint16_t value;
+		bool relative;
+	};
+
+	uint16_t origin;
+	std::vector<uint8_t> out;
+	std::vector<long> labels;
+	std::vector<fixup> fixups;
+
+	constexpr void put(instruction i)
+	{
+		out.push_back(i.opcode);
+
+		if(i.label >= 0)
+			fixups.push_back({out.size(), i.label, i.value, i.relative});
+
+		if(i.size > 1)
+			out.push_back((uint8_t)(i.value & 0xFF));
+
+		if(i.size > 2)
+			out.push_back((uint8_t)(i.value >> 8));
+	}
+};
+
+// the bytes Build(code) makes from origin, evaluated by the compiler
+template<uint16_t Origin, auto Build>
+consteval auto assemble()
+{
+	constexpr size_t n = []
+	{
+		code c(Origin);
+		Build(c);
+		return c.bytes().size();
+	}();
+
+	code c(Origin);
+	Build(c);
+
+	auto b = c.bytes();
+	std::array<uint8_t, n> a{};
+
+	for(size_t i(0); i < n; i++)
+		a[i] = b[i];
+
+	return a;
+}
+
+}
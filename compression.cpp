@@ -0,0 +1,263 @@
+#include "compression.hpp"
+
+#include <algorithm>
+#include <vector>
+
+bool compression::isMethod(std::string method)
+{
+	return method == "rle" || method == "lz4" || method == "lzss";
+}
+
+std::string compression::getError()
+{
+	return error;
+}
+
+bool compression::pack(std::string method, const std::string& data, std::string& packed)
+{
+	if(!isMethod(method))
+	{
+		error = "unknown compression " + method;
+		return false;
+	}
+
+	if(data.size() > COMPRESSION_MAX_SIZE)
+	{
+		error = "more than 65535 bytes to compress";
+		return false;
+	}
+
+	packed = "";
+	packed += (char)(data.size() & 0xFF);
+	packed += (char)(data.size() >> 8);
+
+	if(method == "rle")
+		rle(data, packed);
+	else if(method == "lz4")
+		lz4(data, packed);
+	else
+		lzss(data, packed);
+
+	return true;
+}
+
+void compression::rle(const std::string& data, std::string& out)
+{
+	size_t i = 0;
+	std::string lits = "";
+
+	auto flushLiterals = [&]()
+	{
+		if(lits.size() > 0)
+		{
+			out += (char)lits.size();
+			out += lits;
+			lits = "";
+		}
+	};
+
+	while(i < data.size())
+	{
+		size_t run = 1;
+
+		while(i+run < data.size() && run < 129 && data[i+run] == data[i])
+			run++;
+
+		// a run of 2 costs as much as the literals, but it breaks a literal run
+		if(run >= 3)
+		{
+			flushLiterals();
+			out += (char)(run + 126);
+			out += data[i];
+			i += run;
+			continue;
+		}
+
+		lits += data[i++];
+
+		if(lits.size() == 127)
+			flushLiterals();
+	}
+
+	flushLiterals();
+	out += (char)0;
+}
+
+void compression::lz4(const std::string& data, std::string& out)
+{
+	const size_t MIN_MATCH = 4;
+	// matches end 5 bytes before the end and start 12 before it at the latest
+	const size_t LAST_LITERALS = 5;
+	const size_t MATCH_LIMIT = 12;
+	const size_t HASH_SIZE = 4096;
+
+	std::vector<long> head(HASH_SIZE, -1);
+	std::vector<long> prev(data.size(), -1);
+
+	auto hash = [&](size_t p) -> size_t
+	{
+		unsigned long v = (unsigned char)data[p] | ((unsigned char)data[p+1] << 8) |
+			((unsigned char)data[p+2] << 16) | ((unsigned long)(unsigned char)data[p+3] << 24);
+		return (v * 2654435761UL >> 20) % HASH_SIZE;
+	};
+
+	auto insert = [&](size_t p)
+	{
+		if(p + MIN_MATCH > data.size())
+			return;
+
+		size_t h = hash(p);
+		prev[p] = head[h];
+		head[h] = p;
+	};
+
+	auto putLength = [&](size_t n)
+	{
+		for(; n >= 255; n -= 255)
+			out += (char)255;
+		out += (char)n;
+	};
+
+	size_t anchor = 0;
+	size_t i = 0;
+
+	while(i + MATCH_LIMIT <= data.size())
+	{
+		size_t best_len = 0;
+		size_t best_off = 0;
+		size_t tries = 0;
+
+		for(long c = head[hash(i)]; c >= 0 && i - c <= 0xFFFF && tries < 64; c = prev[c], tries++)
+		{
+			size_t n = 0;
+
+			while(i+n + LAST_LITERALS < data.size() && data[c+n] == data[i+n])
+				n++;
+
+			if(n > best_len)
+			{
+				best_len = n;
+				best_off = i - c;
+			}
+		}
+
+		if(best_len < MIN_MATCH)
+		{
+			insert(i++);
+			continue;
+		}
+
+		size_t lit = i - anchor;
+		size_t ml = best_len - MIN_MATCH;
+
+		out += (char)((std::min<size_t>(lit, 15) << 4) | std::min<size_t>(ml, 15));
+
+		if(lit >= 15)
+			putLength(lit - 15);
+
+		out += data.substr(anchor, lit);
+		out += (char)(best_off & 0xFF);
+		out += (char)(best_off >> 8);
+
+		if(ml >= 15)
+			putLength(ml - 15);
+
+		for(size_t k(0); k < best_len; k++)
+			insert(i+k);
+
+		i += best_len;
+		anchor = i;
+	}
+
+	// the last sequence is literals only
+	size_t lit = data.size() - anchor;
+
+	out += (char)(std::min<size_t>(lit, 15) << 4);
+
+	if(lit >= 15)
+		putLength(lit - 15);
+
+	out += data.substr(anchor);
+}
+
+void compression::lzss(const std::string& data, std::string& out)
+{
+	const size_t MIN_MATCH = 3;
+	const size_t MAX_MATCH = 18;
+	const size_t WINDOW = 4095;
+	const size_t HASH_SIZE = 4096;
+
+	std::vector<long> head(HASH_SIZE, -1);
+	std::vector<long> prev(data.size(), -1);
+
+	auto hash = [&](size_t p) -> size_t
+	{
+		return (((unsigned char)data[p] << 8) ^ ((unsigned char)data[p+1] << 4) ^ (unsigned char)data[p+2]) % HASH_SIZE;
+	};
+
+	auto insert = [&](size_t p)
+	{
+		if(p + MIN_MATCH > data.size())
+			return;
+
+		size_t h = hash(p);
+		prev[p] = head[h];
+		head[h] = p;
+	};
+
+	size_t i = 0;
+
+	while(i < data.size())
+	{
+		size_t flags_pos = out.size();
+		unsigned char flags = 0;
+
+		out += (char)0;
+
+		for(int bit(0); bit < 8 && i < data.size(); bit++)
+		{
+			size_t best_len = 0;
+			size_t best_off = 0;
+
+			size_t tries = 0;
+
+			if(i + MIN_MATCH <= data.size())
+				for(long c = head[hash(i)]; c >= 0 && i - c <= WINDOW && tries < 256; c = prev[c], tries++)
+				{
+					size_t n = 0;
+
+					while(n < MAX_MATCH && i+n < data.size() && data[c+n] == data[i+n])
+						n++;
+
+					if(n > best_len)
+					{
+						best_len = n;
+						best_off = i - c;
+
+						if(n == MAX_MATCH)
+							break;
+					}
+				}
+
+			if(best_len >= MIN_MATCH)
+			{
+				out += (char)(best_off & 0xFF);
+				out += (char)(((best_off >> 8) << 4) | (best_len - MIN_MATCH));
+
+				for(size_t k(0); k < best_len; k++)
+					insert(i+k);
+
+				i += best_len;
+			}
+
+			else
+			{
+				flags |= 1 << bit;
+				insert(i);
+				out += data[i++];
+			}
+		}
+
+		out[flags_pos] = (char)flags;
+	}
+}
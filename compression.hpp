@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+
+const size_t COMPRESSION_MAX_SIZE = 0xFFFF;
+
+// packed data starts with the unpacked size (2 bytes, little endian):
+// rle  - control byte 1..127: that many literals follow, 128..255: the next
+//        byte repeated control-126 times, 0: end
+// lz4  - LZ4 block format (sequences of token, literals, offset, match length)
+// lzss - flag byte per 8 items, bit set (LSB first): literal byte, clear:
+//        match of 2 bytes, offset 1..4095 back with its bits 0-7 in the first
+//        byte and bits 8-11 in the high nibble of the second, length-3 in the
+//        low nibble
+// lib/ has the matching 6502 decompressors
+class compression
+{
+public:
+	static bool isMethod(std::string method);
+
+	bool pack(std::string method, const std::string& data, std::string& packed);
+	std::string getError();
+private:
+	std::string error;
+
+	void rle(const std::string& data, std::string& out);
+	void lz4(const std::string& data, std::string& out);
+	void lzss(const std::string& data, std::string& out);
+};
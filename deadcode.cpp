@@ -0,0 +1,174 @@
+#include "deadcode.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <cctype>
+
+void deadcode::addLabel(size_t line, std::string name, std::string location)
+{
+	if(open)
+		blocks.back().falls = flow;
+	else if(flow || keep_next)
+		kept.insert(blocks.size());
+
+	keep_next = false;
+	index[name] = blocks.size();
+	blocks.push_back({name, location, {line}, {}, true, false});
+
+	open = true;
+	// labels in a row are one routine
+	flow = true;
+}
+
+void deadcode::addBody(size_t line, const std::string& text, bool falls)
+{
+	flow = falls;
+
+	if(!open)
+	{
+		addNames(text, roots);
+		return;
+	}
+
+	blocks.back().lines.push_back(line);
+	addNames(text, blocks.back().refs);
+}
+
+void deadcode::addLayout(const std::string& text)
+{
+	if(open)
+		blocks.back().falls = false;
+
+	addNames(text, roots);
+	open = false;
+	flow = false;
+}
+
+void deadcode::addNeutral(const std::string& text)
+{
+	addNames(text, roots);
+}
+
+void deadcode::keepNext()
+{
+	keep_next = true;
+}
+
+void deadcode::addRoot(std::string name)
+{
+	roots.insert(name);
+}
+
+std::vector<size_t> deadcode::sweep()
+{
+	if(open)
+		blocks.back().falls = false;
+
+	open = false;
+
+	std::vector<size_t> work(kept.begin(), kept.end());
+
+	for(auto& r : roots)
+	{
+		size_t b;
+
+		if(findBlock(r, b))
+			work.push_back(b);
+	}
+
+	while(!work.empty())
+	{
+		size_t b = work.back();
+		work.pop_back();
+
+		if(blocks[b].reached)
+			continue;
+
+		blocks[b].reached = true;
+
+		if(blocks[b].falls && b+1 < blocks.size())
+			work.push_back(b+1);
+
+		for(auto& r : blocks[b].refs)
+		{
+			size_t to;
+
+			if(findBlock(r, to) && !blocks[to].reached)
+				work.push_back(to);
+		}
+	}
+
+	std::vector<size_t> dead;
+
+	for(auto& b : blocks)
+		if(!b.reached)
+			dead.insert(dead.end(), b.lines.begin(), b.lines.end());
+
+	return dead;
+}
+
+std::string deadcode::makeReport()
+{
+	std::stringstream r;
+	size_t removed = 0, lines = 0;
+
+	for(auto& b : blocks)
+	{
+		if(b.reached)
+			continue;
+
+		removed++;
+		lines += b.lines.size();
+	}
+
+	r << "; sfotasm dead code\n";
+	r << "; removed " << removed << " of " << blocks.size() << " blocks, " << lines << " lines\n";
+	r << std::left << std::setw(32) << "name" << std::setw(7) << "lines" << "location\n";
+
+	for(auto& b : blocks)
+		if(!b.reached)
+			r << std::setw(32) << b.name << std::setw(7) << b.lines.size() << b.location << "\n";
+
+	return r.str();
+}
+
+void deadcode::addNames(const std::string& text, std::set<std::string>& names)
+{
+	std::string cur = "";
+
+	// every word counts, a mnemonic or number that matches no label is harmless
+	for(size_t i(0); i <= text.length(); i++)
+	{
+		if(i < text.length() && (std::isalnum((unsigned char)text[i]) || text[i] == '_' || text[i] == '.' || text[i] == '@'))
+		{
+			cur += text[i];
+			continue;
+		}
+
+		if(cur != "")
+			names.insert(cur);
+
+		cur = "";
+	}
+}
+
+bool deadcode::findBlock(std::string name, size_t& block)
+{
+	while(true)
+	{
+		auto f = index.find(name);
+
+		if(f != index.end())
+		{
+			block = f->second;
+			return true;
+		}
+
+		size_t dot = name.rfind('.');
+
+		if(dot == std::string::npos || dot == 0)
+			return false;
+
+		name.erase(dot);
+	}
+}
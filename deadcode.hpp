@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+struct code_block
+{
+	std::string name;
+	// file:line of the label
+	std::string location;
+	// the label and its code and data lines
+	std::vector<size_t> lines;
+	std::set<std::string> refs;
+	// execution runs into the next block
+	bool falls;
+	bool reached;
+};
+
+// --dce: a block is a label with the code and data up to the next label or
+// layout directive. Blocks are kept when a kept line names them or when a kept
+// block runs into them; everything outside blocks is kept and names the roots
+class deadcode
+{
+public:
+	void addLabel(size_t line, std::string name, std::string location);
+	// instruction or data line, falls when execution continues after it
+	void addBody(size_t line, const std::string& text, bool falls);
+	// directive that changes the layout (.org, .bank, ...), ends the block
+	void addLayout(const std::string& text);
+	// directive that emits nothing, kept even inside a removed block
+	void addNeutral(const std::string& text);
+
+	// the next block is kept (a vector table after .org @INTS)
+	void keepNext();
+	void addRoot(std::string name);
+
+	// lines of the unreachable blocks, ascending
+	std::vector<size_t> sweep();
+	std::string makeReport();
+private:
+	std::vector<code_block> blocks;
+	std::map<std::string, size_t> index;
+	std::set<std::string> roots;
+	std::set<size_t> kept;
+
+	bool open = false;
+	bool flow = false;
+	bool keep_next = false;
+
+	void addNames(const std::string& text, std::set<std::string>& names);
+	// block named by a symbol, label.size counts for label
+	bool findBlock(std::string name, size_t& block);
+};
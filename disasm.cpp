@@ -0,0 +1,477 @@
+#include "disasm.hpp"
+
+bool disassembler::load(std::string filename)
+{
+	std::ifstream input(filename, std::ios::binary);
+
+	if(!input.good())
+	{
+		error = filename + " not found";
+		return false;
+	}
+
+	std::vector<unsigned char> data((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+
+	if(data.size() < INES_HEADER_SIZE || data[0] != 'N' || data[1] != 'E' || data[2] != 'S' || data[3] != 0x1A)
+	{
+		error = filename + " is not an iNES file";
+		return false;
+	}
+
+	size_t units = data[4];
+
+	// NES 2.0 size nibbles, as written by preproc::makeHeader()
+	if((data[7] & 0x0C) == 0x08)
+		units |= (data[9] & 0x0F) << 8;
+
+	// trainer
+	size_t start = INES_HEADER_SIZE + (data[6] & 0x04 ? 512 : 0);
+	size_t end = std::min(data.size(), start + units*INES_PRG_UNIT);
+
+	if(start >= end)
+	{
+		error = filename + " has no PRG";
+		return false;
+	}
+
+	prg.assign(data.begin() + start, data.begin() + end);
+	bank_size = prg.size() <= 2*INES_PRG_UNIT ? prg.size() : INES_PRG_UNIT;
+	lines.clear();
+
+	return true;
+}
+
+bool disassembler::loadSymbols(std::string filename)
+{
+	std::ifstream input(filename);
+
+	if(!input.good())
+	{
+		error = filename + " not found";
+		return false;
+	}
+
+	for(std::string line; std::getline(input, line);)
+	{
+		std::istringstream words(line);
+		std::string kind, bank, address, name;
+
+		words >> kind;
+
+		if(kind == "banksize")
+		{
+			words >> address;
+			bank_size = std::stoul(address.substr(1), 0, 16);
+		}
+
+		else if(kind == "bank")
+		{
+			words >> bank >> address;
+			windows[std::stoul(bank)] = std::stoul(address.substr(1), 0, 16);
+		}
+
+		else if(kind == "sym")
+		{
+			words >> bank >> address >> name;
+
+			long b = bank == "-" ? -1 : std::stol(bank);
+			size_t adr = std::stoul(address.substr(1), 0, 16);
+
+			if(b >= 0)
+				labels[{b, adr}] = name;
+			by_address[adr].push_back({b, name});
+		}
+	}
+
+	if(bank_size == 0)
+	{
+		error = filename + ": bad bank size";
+		return false;
+	}
+
+	lines.clear();
+
+	return true;
+}
+
+std::string disassembler::getError()
+{
+	return error;
+}
+
+size_t disassembler::getWindow(size_t bank)
+{
+	auto w = windows.find(bank);
+
+	if(w != windows.end())
+		return w->second;
+
+	if(bank_size >= prg.size())
+		return 0x10000 - bank_size;
+
+	// the fixed bank of UxROM and MMC1 is the last one
+	return (bank+1)*bank_size >= prg.size() ? 0xC000 : 0x8000;
+}
+
+std::string disassembler::getLabel(size_t bank, size_t address)
+{
+	auto l = labels.find({(long)bank, address});
+
+	return l == labels.end() ? "" : l->second;
+}
+
+std::string disassembler::name(size_t bank, size_t address, size_t width)
+{
+	auto s = by_address.find(address);
+
+	if(s == by_address.end())
+		return "$" + hexNum(address, width);
+
+	// the bank's own label first, then RAM, then any bank
+	for(auto& sym : s->second)
+		if(sym.bank == (long)bank)
+			return sym.name;
+
+	for(auto& sym : s->second)
+		if(sym.bank < 0)
+			return sym.name;
+
+	return s->second.front().name;
+}
+
+const std::vector<disasm_line>& disassembler::getLines()
+{
+	if(lines.empty())
+		decode();
+
+	return lines;
+}
+
+void disassembler::decode()
+{
+	static const char* vector_names[] = {"NMI", "RESET", "IRQ"};
+
+	lines.clear();
+
+	for(size_t bank(0); bank*bank_size < prg.size(); bank++)
+	{
+		size_t base = bank*bank_size;
+		size_t end = std::min(base + bank_size, prg.size());
+		size_t window = getWindow(bank);
+
+		bool vectors = window + bank_size == 0x10000 && end - base == bank_size;
+		size_t stop = vectors ? end - 6 : end;
+
+		for(size_t off = base; off < stop;)
+		{
+			size_t adr = window + off - base;
+			disasm_line l = {bank, adr, getLabel(bank, adr), "", ""};
+
+			// unused space
+			size_t run = 0;
+
+			while(off+run < stop && prg[off+run] == 0xFF && (run == 0 || getLabel(bank, adr+run) == ""))
+				run++;
+
+			if(run >= 16)
+			{
+				l.text = "; " + std::to_string(run) + " bytes of $FF";
+				lines.push_back(l);
+				off += run;
+				continue;
+			}
+
+			auto info = codes.getOpcodeInfo(prg[off]);
+			size_t size = info.size;
+			bool data = info.name == "" || off + size > stop;
+
+			// a label inside the instruction means this is data
+			for(size_t k(1); k < size && !data; k++)
+				data = getLabel(bank, adr+k) != "";
+
+			if(data)
+			{
+				l.hex = hexNum(prg[off], 2);
+				l.text = ".db $" + l.hex;
+				lines.push_back(l);
+				off++;
+				continue;
+			}
+
+			size_t v = size == 1 ? 0 : size == 2 ? prg[off+1] : prg[off+1] | (prg[off+2] << 8);
+
+			for(size_t k(0); k < size; k++)
+				l.hex += (k ? " " : "") + hexNum(prg[off+k], 2);
+
+			l.text = info.name;
+
+			switch(info.type)
+			{
+				case IMPLIED:
+					break;
+				case IMM:
+					l.text += " #$" + hexNum(v, 2);
+					break;
+				case ZP:
+					l.text += " " + name(bank, v, 2);
+					break;
+				case ZPX:
+					l.text += " " + name(bank, v, 2) + ",X";
+					break;
+				case ZPY:
+					l.text += " " + name(bank, v, 2) + ",Y";
+					break;
+				case INDX:
+					l.text += " (" + name(bank, v, 2) + ",X)";
+					break;
+				case INDY:
+					l.text += " (" + name(bank, v, 2) + "),Y";
+					break;
+				case ABS:
+					l.text += " " + name(bank, v, 4);
+					break;
+				case ABSX:
+					l.text += " " + name(bank, v, 4) + ",X";
+					break;
+				case ABSY:
+					l.text += " " + name(bank, v, 4) + ",Y";
+					break;
+				case IND:
+					l.text += " (" + name(bank, v, 4) + ")";
+					break;
+				case REL:
+					l.text += " " + name(bank, (adr + 2 + (signed char)v) & 0xFFFF, 4);
+					break;
+			}
+
+			lines.push_back(l);
+			off += size;
+		}
+
+		for(size_t i(0); vectors && i < 3; i++)
+		{
+			size_t off = end - 6 + 2*i;
+			size_t adr = window + off - base;
+			size_t v = prg[off] | (prg[off+1] << 8);
+
+			disasm_line l = {bank, adr, getLabel(bank, adr), hexNum(prg[off], 2) + " " + hexNum(prg[off+1], 2), ""};
+
+			l.text = ".dw " + name(bank, v, 4) + " ; " + vector_names[i];
+			lines.push_back(l);
+		}
+	}
+}
+
+std::string disassembler::formatLine(const disasm_line& l, bool with_hex)
+{
+	std::string s = hexNum(l.address, 4) + "  ";
+
+	if(with_hex)
+		s += l.hex + std::string(l.hex.length() < 10 ? 10 - l.hex.length() : 1, ' ');
+
+	if(l.label != "")
+		s += l.label + ": ";
+
+	return s + l.text;
+}
+
+std::string disassembler::listing()
+{
+	std::string out = "";
+	size_t bank = (size_t)-1;
+
+	for(auto& l : getLines())
+	{
+		if(l.bank != bank)
+		{
+			bank = l.bank;
+			out += (out == "" ? "" : "\n") + std::string("; bank ") + std::to_string(bank) + " at $" + hexNum(getWindow(bank), 4) + "\n";
+		}
+
+		if(l.label != "")
+			out += l.label + ":\n";
+
+		disasm_line row = l;
+		row.label = "";
+		out += "\t" + formatLine(row, true) + "\n";
+	}
+
+	return out;
+}
+
+std::string disassembler::diff(disassembler& other)
+{
+	auto& a_lines = getLines();
+	auto& b_lines = other.getLines();
+
+	// lines compare by label and text, moved code with symbols still matches
+	std::map<std::string, int> ids;
+	std::vector<int> a, b;
+
+	for(auto& l : a_lines)
+		a.push_back(ids.emplace(l.label + ":" + l.text, ids.size()).first->second);
+
+	for(auto& l : b_lines)
+		b.push_back(ids.emplace(l.label + ":" + l.text, ids.size()).first->second);
+
+	size_t pre = 0;
+
+	while(pre < a.size() && pre < b.size() && a[pre] == b[pre])
+		pre++;
+
+	size_t post = 0;
+
+	while(post < a.size()-pre && post < b.size()-pre && a[a.size()-1-post] == b[b.size()-1-post])
+		post++;
+
+	long n = a.size() - pre - post;
+	long m = b.size() - pre - post;
+
+	// edit script: 0 same, 1 only in a, 2 only in b
+	std::vector<char> ops(pre, 0);
+	std::vector<char> middle;
+
+	// Myers' O(ND) diff, each step keeps its diagonals for the way back
+	std::vector<std::vector<long>> trace;
+	std::vector<long> v(2*(n+m)+3, 0);
+	long offset = n+m+1;
+	bool found = n == 0 && m == 0;
+
+	for(long d(0); !found && d <= n+m && d <= (long)DIFF_MAX_EDITS; d++)
+	{
+		trace.push_back(std::vector<long>(v.begin() + offset - d - 1, v.begin() + offset + d + 2));
+
+		for(long k(-d); k <= d; k += 2)
+		{
+			long x;
+
+			if(k == -d || (k != d && v[offset+k-1] < v[offset+k+1]))
+				x = v[offset+k+1];
+			else
+				x = v[offset+k-1] + 1;
+
+			long y = x - k;
+
+			while(x < n && y < m && a[pre+x] == b[pre+y])
+			{
+				x++;
+				y++;
+			}
+
+			v[offset+k] = x;
+
+			if(x >= n && y >= m)
+			{
+				found = true;
+				break;
+			}
+		}
+	}
+
+	if(found)
+	{
+		long x = n;
+		long y = m;
+
+		for(long d = trace.size()-1; d >= 0 && (x > 0 || y > 0); d--)
+		{
+			auto& t = trace[d];
+			// t holds diagonals -d-1 .. d+1
+			auto at = [&](long k) { return t[k + d + 1]; };
+			long k = x - y;
+			long prev_k;
+
+			if(k == -d || (k != d && at(k-1) < at(k+1)))
+				prev_k = k+1;
+			else
+				prev_k = k-1;
+
+			long prev_x = d == 0 ? 0 : at(prev_k);
+			long prev_y = prev_x - prev_k;
+
+			while(x > prev_x && y > prev_y)
+			{
+				middle.push_back(0);
+				x--;
+				y--;
+			}
+
+			if(d > 0)
+				middle.push_back(x == prev_x ? 2 : 1);
+
+			x = prev_x;
+			y = prev_y;
+		}
+
+		std::reverse(middle.begin(), middle.end());
+	}
+
+	// too different to align, the rest is replaced
+	else
+	{
+		middle.assign(n, 1);
+		middle.insert(middle.end(), m, 2);
+	}
+
+	ops.insert(ops.end(), middle.begin(), middle.end());
+	ops.insert(ops.end(), post, 0);
+
+	// hunks with DIFF_CONTEXT common lines around the changes
+	std::string out = "";
+	std::vector<size_t> ai, bi;
+	size_t x = 0, y = 0;
+
+	for(auto op : ops)
+	{
+		ai.push_back(x);
+		bi.push_back(y);
+
+		if(op != 2)
+			x++;
+		if(op != 1)
+			y++;
+	}
+
+	size_t shown = 0;
+
+	for(size_t i(0); i < ops.size(); i++)
+	{
+		if(ops[i] == 0)
+			continue;
+
+		size_t from = i > DIFF_CONTEXT ? i - DIFF_CONTEXT : 0;
+
+		if(from < shown)
+			from = shown;
+
+		if(from >= shown && (shown == 0 || from > shown))
+		{
+			auto& l = ai[from] < a_lines.size() ? a_lines[ai[from]] : b_lines[bi[from]];
+			out += "@@ bank " + std::to_string(l.bank) + " $" + hexNum(l.address, 4) + " @@\n";
+		}
+
+		// the hunk ends DIFF_CONTEXT common lines after its last change
+		size_t to = i;
+		size_t common = 0;
+
+		for(; to < ops.size() && common <= 2*DIFF_CONTEXT; to++)
+			common = ops[to] == 0 ? common+1 : 0;
+
+		to = std::min(ops.size(), to - common + std::min(common, DIFF_CONTEXT));
+
+		for(size_t j(from); j < to; j++)
+		{
+			if(ops[j] == 0)
+				out += "  " + formatLine(a_lines[ai[j]], false) + "\n";
+			else if(ops[j] == 1)
+				out += "- " + formatLine(a_lines[ai[j]], false) + "\n";
+			else
+				out += "+ " + formatLine(b_lines[bi[j]], false) + "\n";
+		}
+
+		shown = to;
+		i = to - 1;
+	}
+
+	return out;
+}
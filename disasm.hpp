@@ -0,0 +1,67 @@
+#pragma once
+
+#include "opcodes.hpp"
+
+#include <iterator>
+
+const size_t INES_HEADER_SIZE = 16;
+const size_t INES_PRG_UNIT = 0x4000;
+// common lines around each difference
+const size_t DIFF_CONTEXT = 3;
+// edit distance where the diff gives up on aligning and replaces the rest
+const size_t DIFF_MAX_EDITS = 2000;
+
+struct disasm_line
+{
+	size_t bank;
+	size_t address;
+	std::string label;
+	std::string hex;
+	std::string text;
+};
+
+// linear sweep over the PRG of an iNES ROM with the opcode decode table.
+// Bank windows and labels come from the .sym file the assembler writes with
+// --sym; without one, 16/32 KB PRG ends at $FFFF and bigger PRG is split into
+// 16 KB banks at $8000 with the last one at $C000
+class disassembler
+{
+public:
+	// false when the file isn't an iNES ROM, see getError()
+	bool load(std::string filename);
+	bool loadSymbols(std::string filename);
+
+	const std::vector<disasm_line>& getLines();
+	std::string listing();
+
+	// instruction level differences to other, "" when the PRG decodes the same
+	std::string diff(disassembler& other);
+
+	std::string getError();
+private:
+	struct symbol
+	{
+		// -1 for RAM symbols
+		long bank;
+		std::string name;
+	};
+
+	std::vector<unsigned char> prg;
+	size_t bank_size = INES_PRG_UNIT;
+	std::map<size_t, size_t> windows;
+
+	// by bank and address
+	std::map<std::pair<long, size_t>, std::string> labels;
+	std::map<size_t, std::vector<symbol>> by_address;
+
+	opcodes codes;
+	std::vector<disasm_line> lines;
+	std::string error;
+
+	void decode();
+	size_t getWindow(size_t bank);
+	std::string getLabel(size_t bank, size_t address);
+	// symbol or $hex for an operand
+	std::string name(size_t bank, size_t address, size_t width);
+	std::string formatLine(const disasm_line& l, bool with_hex);
+};
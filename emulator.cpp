@@ -0,0 +1,579 @@
+#include "emulator.hpp"
+
+#include <iomanip>
+
+const unsigned char FLAG_C = 0x01;
+const unsigned char FLAG_Z = 0x02;
+const unsigned char FLAG_I = 0x04;
+const unsigned char FLAG_D = 0x08;
+const unsigned char FLAG_B = 0x10;
+const unsigned char FLAG_U = 0x20;
+const unsigned char FLAG_V = 0x40;
+const unsigned char FLAG_N = 0x80;
+
+emulator::emulator()
+{
+	std::string names[] = {"", "ADC", "AND", "ASL", "BCC", "BCS", "BEQ", "BIT", "BMI",
+		"BNE", "BPL", "BRK", "BVC", "BVS", "CLC", "CLD", "CLI", "CLV",
+		"CMP", "CPX", "CPY", "DEC", "DEX", "DEY", "EOR", "INC", "INX",
+		"INY", "JMP", "JSR", "LDA", "LDX", "LDY", "LSR", "NOP", "ORA",
+		"PHA", "PHP", "PLA", "PLP", "ROL", "ROR", "RTI", "RTS", "SBC",
+		"SEC", "SED", "SEI", "STA", "STX", "STY", "TAX", "TAY", "TSX",
+		"TXA", "TXS", "TYA",
+		"SLO", "RLA", "SRE", "RRA", "SAX", "LAX", "DCP", "ISC", "ANC",
+		"ALR", "ARR", "XAA", "AXS", "AHX", "SHY", "SHX", "TAS", "LAS"};
+
+	std::map<std::string, OPERATION> by_name;
+
+	for(int i(1); i <= OP_LAS; i++)
+		by_name[names[i]] = (OPERATION)i;
+
+	for(int i(0); i < 256; i++)
+	{
+		info[i] = codes.getOpcodeInfo(i);
+		ops[i] = info[i].name == "" ? OP_NONE : by_name[info[i].name];
+	}
+
+	std::fill(ram, ram + sizeof(ram), 0);
+	std::fill(mem, mem + sizeof(mem), 0xFF);
+	std::fill(rom_loaded, rom_loaded + 8, false);
+
+	owner.assign(0x10000, -1);
+	unlabelled = {"(unlabelled)", 0, 0, 0, 0};
+
+	cycles = 0;
+	frame_cycles = 0;
+	frames = 0;
+	stall = 0;
+	vblank = false;
+	in_vblank = false;
+	nmi_enabled = false;
+	returned = false;
+}
+
+void emulator::loadBank(const std::vector<unsigned char>& data, size_t address)
+{
+	for(size_t i(0); i < data.size(); i++)
+	{
+		size_t adr = address + i;
+
+		if(adr < 0x6000 || adr > 0xFFFF)
+			continue;
+
+		mem[adr] = data[i];
+		rom_loaded[adr >> 13] = true;
+	}
+}
+
+void emulator::setLabels(std::map<std::string, size_t> labels)
+{
+	profile.clear();
+	starts.clear();
+
+	for(auto i : labels)
+		if(i.second <= 0xFFFF)
+			profile.push_back({i.first, i.second, 0, 0, 0});
+
+	std::stable_sort(profile.begin(), profile.end(),
+		[](const profile_entry& l, const profile_entry& r) { return l.address < r.address; });
+
+	owner.assign(0x10000, -1);
+
+	for(size_t i(0); i < profile.size(); i++)
+	{
+		size_t end = i+1 < profile.size() ? profile[i+1].address : 0x10000;
+
+		for(size_t adr(profile[i].address); adr < end; adr++)
+			owner[adr] = i;
+
+		starts[profile[i].address] = i;
+	}
+}
+
+EMU_STOP emulator::run(std::string entry, size_t max_frames, size_t max_cycles)
+{
+	// NROM-128 and friends: mirror the upper 16kb when nothing was placed at $8000
+	if(!rom_loaded[4] && !rom_loaded[5])
+		std::copy(mem + 0xC000, mem + 0x10000, mem + 0x8000);
+
+	a = x = y = 0;
+	s = 0xFD;
+	p = FLAG_I | FLAG_U;
+	depth = 0;
+	entry_label = entry;
+
+	if(entry == "")
+		pc = readWord(RESET_VECTOR);
+	else
+	{
+		for(auto i : profile)
+			if(i.label == entry)
+				pc = i.address;
+	}
+
+	countCall(pc);
+
+	while(true)
+	{
+		if(max_cycles && cycles >= max_cycles)
+			return STOP_LIMIT;
+		if(max_frames && frames >= max_frames)
+			return STOP_LIMIT;
+
+		size_t before = cycles;
+
+		if(!step())
+			return returned ? STOP_RETURN : STOP_JAM;
+
+		frame_cycles += cycles - before;
+
+		if(!in_vblank && frame_cycles >= VBLANK_CYCLE)
+		{
+			in_vblank = true;
+			vblank = true;
+
+			if(nmi_enabled)
+				interrupt(NMI_VECTOR);
+		}
+
+		if(frame_cycles >= FRAME_CYCLES)
+		{
+			frame_cycles -= FRAME_CYCLES;
+			frames++;
+			in_vblank = false;
+			vblank = false;
+		}
+	}
+}
+
+std::string emulator::makeReport()
+{
+	std::vector<profile_entry> sorted;
+
+	for(auto i : profile)
+		if(i.cycles || i.calls)
+			sorted.push_back(i);
+
+	if(unlabelled.cycles)
+		sorted.push_back(unlabelled);
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const profile_entry& l, const profile_entry& r) { return l.cycles > r.cycles; });
+
+	std::stringstream r;
+
+	r << "; sfotasm profile\n";
+	r << "; entry: " << (entry_label == "" ? "reset" : entry_label);
+	r << ", frames: " << frames << ", cycles: " << cycles << "\n";
+
+	if(error != "")
+		r << "; stopped: " << error << "\n";
+
+	r << std::left << std::setw(32) << "label" << std::setw(9) << "address";
+	r << std::setw(14) << "cycles" << std::setw(9) << "%";
+	r << std::setw(10) << "calls" << "instructions\n";
+
+	for(auto i : sorted)
+	{
+		double pc = cycles ? 100.0 * i.cycles / cycles : 0;
+
+		r << std::setw(32) << i.label << std::setw(9) << ("$" + hexNum(i.address, 4));
+		r << std::setw(14) << i.cycles << std::setw(9) << std::fixed << std::setprecision(2) << pc;
+		r << std::setw(10) << i.calls << i.instructions << "\n";
+	}
+
+	return r.str();
+}
+
+std::string emulator::getError()
+{
+	return error;
+}
+
+unsigned char emulator::read(unsigned short adr)
+{
+	if(adr < 0x2000)
+		return ram[adr & 0x7FF];
+
+	if(adr < 0x4000)
+	{
+		if((adr & 7) == 2)
+		{
+			unsigned char st = vblank ? 0x80 : 0;
+			vblank = false;
+			return st;
+		}
+
+		return 0;
+	}
+
+	if(adr < 0x6000)
+		return 0;
+
+	return mem[adr];
+}
+
+void emulator::write(unsigned short adr, unsigned char v)
+{
+	if(adr < 0x2000)
+		ram[adr & 0x7FF] = v;
+
+	else if(adr < 0x4000)
+	{
+		if((adr & 7) == 0)
+			nmi_enabled = v & 0x80;
+	}
+
+	else if(adr == 0x4014)
+		stall += OAM_DMA_CYCLES;
+
+	else if(adr >= 0x6000 && adr < 0x8000)
+		mem[adr] = v;
+}
+
+void emulator::push(unsigned char v)
+{
+	write(0x100 + s, v);
+	s--;
+}
+
+unsigned char emulator::pull()
+{
+	s++;
+	return read(0x100 + s);
+}
+
+unsigned short emulator::readWord(unsigned short adr)
+{
+	return read(adr) | (read(adr+1) << 8);
+}
+
+void emulator::setZN(unsigned char v)
+{
+	p = (p & ~(FLAG_Z | FLAG_N)) | (v ? 0 : FLAG_Z) | (v & FLAG_N);
+}
+
+void emulator::compare(unsigned char reg, unsigned char v)
+{
+	p = (p & ~FLAG_C) | (reg >= v ? FLAG_C : 0);
+	setZN(reg - v);
+}
+
+void emulator::adc(unsigned char v)
+{
+	unsigned int sum = a + v + (p & FLAG_C);
+
+	p &= ~(FLAG_C | FLAG_V);
+
+	if(sum > 0xFF)
+		p |= FLAG_C;
+	if(~(a ^ v) & (a ^ sum) & 0x80)
+		p |= FLAG_V;
+
+	a = sum;
+	setZN(a);
+}
+
+unsigned char emulator::shift(OPERATION op, unsigned char v)
+{
+	unsigned char carry = p & FLAG_C;
+	unsigned char out;
+
+	if(op == OP_ASL || op == OP_ROL)
+	{
+		out = v & 0x80;
+		v <<= 1;
+
+		if(op == OP_ROL)
+			v |= carry;
+	}
+
+	else
+	{
+		out = v & 0x01;
+		v >>= 1;
+
+		if(op == OP_ROR)
+			v |= carry << 7;
+	}
+
+	p = (p & ~FLAG_C) | (out ? FLAG_C : 0);
+	setZN(v);
+
+	return v;
+}
+
+void emulator::interrupt(unsigned short vector)
+{
+	push(pc >> 8);
+	push(pc & 0xFF);
+	push((p & ~FLAG_B) | FLAG_U);
+
+	p |= FLAG_I;
+	pc = readWord(vector);
+	cycles += 7;
+
+	profile_entry& pe = owner[pc] < 0 ? unlabelled : profile[owner[pc]];
+	pe.cycles += 7;
+
+	countCall(pc);
+}
+
+void emulator::countCall(unsigned short adr)
+{
+	auto st = starts.find(adr);
+
+	if(st != starts.end())
+		profile[st->second].calls++;
+}
+
+bool emulator::step()
+{
+	unsigned short start = pc;
+	unsigned char code = read(pc);
+	OPERATION op = ops[code];
+	opcode_info& in = info[code];
+
+	if(op == OP_NONE)
+	{
+		error = "unknown opcode $" + hexNum(code, 2) + " at $" + hexNum(pc, 4);
+		return false;
+	}
+
+	unsigned short adr = 0;
+	unsigned short base = 0;
+	unsigned char zp = 0;
+	size_t spent = in.cycles;
+
+	switch(in.type)
+	{
+		case IMM:
+			adr = pc + 1;
+			break;
+		case ZP:
+			adr = read(pc + 1);
+			break;
+		case ZPX:
+			adr = (read(pc + 1) + x) & 0xFF;
+			break;
+		case ZPY:
+			adr = (read(pc + 1) + y) & 0xFF;
+			break;
+		case ABS:
+			adr = readWord(pc + 1);
+			break;
+		case ABSX:
+			base = readWord(pc + 1);
+			adr = base + x;
+			break;
+		case ABSY:
+			base = readWord(pc + 1);
+			adr = base + y;
+			break;
+		case INDX:
+			zp = read(pc + 1) + x;
+			adr = read(zp) | (read((unsigned char)(zp + 1)) << 8);
+			break;
+		case INDY:
+			zp = read(pc + 1);
+			base = read(zp) | (read((unsigned char)(zp + 1)) << 8);
+			adr = base + y;
+			break;
+		case IND:
+			base = readWord(pc + 1);
+			adr = read(base) | (read((base & 0xFF00) | ((base + 1) & 0xFF)) << 8);
+			break;
+		case REL:
+			adr = pc + 2 + (signed char)read(pc + 1);
+			break;
+		default:
+			break;
+	}
+
+	if(in.page_cycle && (in.type == ABSX || in.type == ABSY || in.type == INDY))
+		if((base & 0xFF00) != (adr & 0xFF00))
+			spent++;
+
+	pc += in.size;
+
+	bool branch = false;
+	unsigned char v;
+
+	switch(op)
+	{
+		case OP_ADC: adc(read(adr)); break;
+		case OP_SBC: adc(read(adr) ^ 0xFF); break;
+		case OP_AND: a &= read(adr); setZN(a); break;
+		case OP_ORA: a |= read(adr); setZN(a); break;
+		case OP_EOR: a ^= read(adr); setZN(a); break;
+
+		case OP_ASL:
+		case OP_LSR:
+		case OP_ROL:
+		case OP_ROR:
+			if(in.type == IMPLIED)
+				a = shift(op, a);
+			else
+				write(adr, shift(op, read(adr)));
+			break;
+
+		case OP_BCC: branch = !(p & FLAG_C); break;
+		case OP_BCS: branch = p & FLAG_C; break;
+		case OP_BNE: branch = !(p & FLAG_Z); break;
+		case OP_BEQ: branch = p & FLAG_Z; break;
+		case OP_BPL: branch = !(p & FLAG_N); break;
+		case OP_BMI: branch = p & FLAG_N; break;
+		case OP_BVC: branch = !(p & FLAG_V); break;
+		case OP_BVS: branch = p & FLAG_V; break;
+
+		case OP_BIT:
+			v = read(adr);
+			p = (p & ~(FLAG_Z | FLAG_V | FLAG_N)) | (v & (FLAG_V | FLAG_N)) | ((a & v) ? 0 : FLAG_Z);
+			break;
+
+		case OP_BRK:
+			pc++;
+			push(pc >> 8);
+			push(pc & 0xFF);
+			push(p | FLAG_B | FLAG_U);
+			p |= FLAG_I;
+			pc = readWord(IRQ_VECTOR);
+			countCall(pc);
+			break;
+
+		case OP_CLC: p &= ~FLAG_C; break;
+		case OP_CLD: p &= ~FLAG_D; break;
+		case OP_CLI: p &= ~FLAG_I; break;
+		case OP_CLV: p &= ~FLAG_V; break;
+		case OP_SEC: p |= FLAG_C; break;
+		case OP_SED: p |= FLAG_D; break;
+		case OP_SEI: p |= FLAG_I; break;
+
+		case OP_CMP: compare(a, read(adr)); break;
+		case OP_CPX: compare(x, read(adr)); break;
+		case OP_CPY: compare(y, read(adr)); break;
+
+		case OP_DEC: v = read(adr) - 1; write(adr, v); setZN(v); break;
+		case OP_INC: v = read(adr) + 1; write(adr, v); setZN(v); break;
+		case OP_DEX: x--; setZN(x); break;
+		case OP_DEY: y--; setZN(y); break;
+		case OP_INX: x++; setZN(x); break;
+		case OP_INY: y++; setZN(y); break;
+
+		case OP_JMP: pc = adr; break;
+
+		case OP_JSR:
+			pc--;
+			push(pc >> 8);
+			push(pc & 0xFF);
+			pc = adr;
+			depth++;
+			countCall(adr);
+			break;
+
+		case OP_RTS:
+			if(depth == 0 && entry_label != "")
+			{
+				returned = true;
+				break;
+			}
+
+			pc = pull();
+			pc |= pull() << 8;
+			pc++;
+			depth--;
+			break;
+
+		case OP_RTI:
+			p = (pull() & ~FLAG_B) | FLAG_U;
+			pc = pull();
+			pc |= pull() << 8;
+			break;
+
+		case OP_LDA: a = read(adr); setZN(a); break;
+		case OP_LDX: x = read(adr); setZN(x); break;
+		case OP_LDY: y = read(adr); setZN(y); break;
+		case OP_STA: write(adr, a); break;
+		case OP_STX: write(adr, x); break;
+		case OP_STY: write(adr, y); break;
+
+		case OP_NOP: break;
+
+		case OP_PHA: push(a); break;
+		case OP_PHP: push(p | FLAG_B | FLAG_U); break;
+		case OP_PLA: a = pull(); setZN(a); break;
+		case OP_PLP: p = (pull() & ~FLAG_B) | FLAG_U; break;
+
+		case OP_TAX: x = a; setZN(x); break;
+		case OP_TAY: y = a; setZN(y); break;
+		case OP_TSX: x = s; setZN(x); break;
+		case OP_TXA: a = x; setZN(a); break;
+		case OP_TXS: s = x; break;
+		case OP_TYA: a = y; setZN(a); break;
+
+		case OP_SLO: v = shift(OP_ASL, read(adr)); write(adr, v); a |= v; setZN(a); break;
+		case OP_RLA: v = shift(OP_ROL, read(adr)); write(adr, v); a &= v; setZN(a); break;
+		case OP_SRE: v = shift(OP_LSR, read(adr)); write(adr, v); a ^= v; setZN(a); break;
+		case OP_RRA: v = shift(OP_ROR, read(adr)); write(adr, v); adc(v); break;
+		case OP_DCP: v = read(adr) - 1; write(adr, v); compare(a, v); break;
+		case OP_ISC: v = read(adr) + 1; write(adr, v); adc(v ^ 0xFF); break;
+		case OP_SAX: write(adr, a & x); break;
+		case OP_LAX: a = x = read(adr); setZN(a); break;
+		case OP_LAS: a = x = s = read(adr) & s; setZN(a); break;
+
+		case OP_ANC:
+			a &= read(adr);
+			setZN(a);
+			p = (p & ~FLAG_C) | ((a & 0x80) ? FLAG_C : 0);
+			break;
+
+		case OP_ALR:
+			a &= read(adr);
+			a = shift(OP_LSR, a);
+			break;
+
+		case OP_ARR:
+			a &= read(adr);
+			a = (a >> 1) | ((p & FLAG_C) << 7);
+			setZN(a);
+			p = (p & ~(FLAG_C | FLAG_V)) | ((a & 0x40) ? FLAG_C : 0) | (((a >> 6) ^ (a >> 5)) & 1 ? FLAG_V : 0);
+			break;
+
+		case OP_AXS:
+			v = read(adr);
+			p = (p & ~FLAG_C) | ((a & x) >= v ? FLAG_C : 0);
+			x = (a & x) - v;
+			setZN(x);
+			break;
+
+		case OP_XAA: a = x & read(adr); setZN(a); break;
+		case OP_AHX: write(adr, a & x & ((adr >> 8) + 1)); break;
+		case OP_SHY: write(adr, y & ((adr >> 8) + 1)); break;
+		case OP_SHX: write(adr, x & ((adr >> 8) + 1)); break;
+		case OP_TAS: s = a & x; write(adr, s & ((adr >> 8) + 1)); break;
+
+		default:
+			break;
+	}
+
+	if(branch)
+	{
+		spent++;
+
+		if((pc & 0xFF00) != (adr & 0xFF00))
+			spent++;
+
+		pc = adr;
+	}
+
+	spent += stall;
+	stall = 0;
+
+	profile_entry& pe = owner[start] < 0 ? unlabelled : profile[owner[start]];
+	pe.cycles += spent;
+	pe.instructions++;
+
+	cycles += spent;
+
+	return !returned;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "opcodes.hpp"
+
+const size_t FRAME_CYCLES = 29781;
+const size_t VBLANK_CYCLE = 27394;
+const size_t OAM_DMA_CYCLES = 513;
+
+const unsigned short NMI_VECTOR = 0xFFFA;
+const unsigned short RESET_VECTOR = 0xFFFC;
+const unsigned short IRQ_VECTOR = 0xFFFE;
+
+enum EMU_STOP
+{
+	STOP_LIMIT,
+	STOP_RETURN,
+	STOP_JAM
+};
+
+struct profile_entry
+{
+	std::string label;
+	size_t address;
+	size_t cycles;
+	size_t calls;
+	size_t instructions;
+};
+
+// headless 6502 core: RAM, PRG-RAM and PRG-ROM, PPU/APU registers are stubs
+class emulator
+{
+public:
+	emulator();
+
+	void loadBank(const std::vector<unsigned char>& data, size_t address);
+	void setLabels(std::map<std::string, size_t> labels);
+
+	// entry == "" starts from the reset vector, limits of 0 are ignored
+	EMU_STOP run(std::string entry, size_t max_frames, size_t max_cycles);
+
+	std::string makeReport();
+	std::string getError();
+private:
+	opcodes codes;
+
+	enum OPERATION
+	{
+		OP_NONE, OP_ADC, OP_AND, OP_ASL, OP_BCC, OP_BCS, OP_BEQ, OP_BIT, OP_BMI,
+		OP_BNE, OP_BPL, OP_BRK, OP_BVC, OP_BVS, OP_CLC, OP_CLD, OP_CLI, OP_CLV,
+		OP_CMP, OP_CPX, OP_CPY, OP_DEC, OP_DEX, OP_DEY, OP_EOR, OP_INC, OP_INX,
+		OP_INY, OP_JMP, OP_JSR, OP_LDA, OP_LDX, OP_LDY, OP_LSR, OP_NOP, OP_ORA,
+		OP_PHA, OP_PHP, OP_PLA, OP_PLP, OP_ROL, OP_ROR, OP_RTI, OP_RTS, OP_SBC,
+		OP_SEC, OP_SED, OP_SEI, OP_STA, OP_STX, OP_STY, OP_TAX, OP_TAY, OP_TSX,
+		OP_TXA, OP_TXS, OP_TYA,
+		OP_SLO, OP_RLA, OP_SRE, OP_RRA, OP_SAX, OP_LAX, OP_DCP, OP_ISC, OP_ANC,
+		OP_ALR, OP_ARR, OP_XAA, OP_AXS, OP_AHX, OP_SHY, OP_SHX, OP_TAS, OP_LAS
+	};
+
+	OPERATION ops[256];
+	opcode_info info[256];
+
+	unsigned char ram[0x800];
+	unsigned char mem[0x10000];
+	bool rom_loaded[8];
+
+	unsigned char a, x, y, s, p;
+	unsigned short pc;
+
+	size_t cycles;
+	size_t frame_cycles;
+	size_t frames;
+	size_t stall;
+
+	bool vblank;
+	bool in_vblank;
+	bool nmi_enabled;
+	bool returned;
+
+	int depth;
+	std::string entry_label;
+	std::string error;
+
+	std::vector<profile_entry> profile;
+	std::vector<int> owner;
+	std::map<size_t, int> starts;
+	profile_entry unlabelled;
+
+	unsigned char read(unsigned short adr);
+	void write(unsigned short adr, unsigned char v);
+
+	void push(unsigned char v);
+	unsigned char pull();
+	unsigned short readWord(unsigned short adr);
+
+	void setZN(unsigned char v);
+	void compare(unsigned char reg, unsigned char v);
+	void adc(unsigned char v);
+	unsigned char shift(OPERATION op, unsigned char v);
+
+	void interrupt(unsigned short vector);
+	void countCall(unsigned short adr);
+
+	// returns false when the program can't go on
+	bool step();
+};
@@ -0,0 +1,492 @@
+#include "expressions.hpp"
+
+#include <cmath>
+#include <cctype>
+
+bool expressions::evaluate(std::string expr, std::map<std::string, size_t>& symbols, long& value)
+{
+	text = expr;
+	pos = 0;
+	syms = &symbols;
+	error = "";
+	undefined = false;
+	names.clear();
+
+	if(!parseCompare(value))
+		return false;
+
+	skipSpaces();
+
+	if(pos != text.length())
+		return fail("unexpected '" + text.substr(pos) + "'");
+
+	return !undefined;
+}
+
+std::vector<std::string> expressions::getNames(std::string expr)
+{
+	std::map<std::string, size_t> none;
+	long v;
+
+	evaluate(expr, none, v);
+
+	return names;
+}
+
+const std::vector<std::string>& expressions::getLastNames()
+{
+	return names;
+}
+
+std::string expressions::getError()
+{
+	return error;
+}
+
+bool expressions::isUndefined()
+{
+	return undefined;
+}
+
+bool expressions::fail(std::string err)
+{
+	if(error == "")
+		error = err;
+	return false;
+}
+
+void expressions::skipSpaces()
+{
+	while(pos < text.length() && (text[pos] == ' ' || text[pos] == '\t'))
+		pos++;
+}
+
+bool expressions::accept(std::string tok)
+{
+	skipSpaces();
+
+	if(text.compare(pos, tok.length(), tok) != 0)
+		return false;
+
+	// keep < and > apart from << and >>
+	if(tok.length() == 1 && (tok == "<" || tok == ">") && pos+1 < text.length() && text[pos+1] == tok[0])
+		return false;
+
+	pos += tok.length();
+	return true;
+}
+
+bool expressions::parseCompare(long& v)
+{
+	if(!parseOr(v))
+		return false;
+
+	long r;
+
+	while(true)
+	{
+		if(accept("=="))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v == r;
+		}
+
+		else if(accept("!="))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v != r;
+		}
+
+		else if(accept("<="))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v <= r;
+		}
+
+		else if(accept(">="))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v >= r;
+		}
+
+		// after an operand < and > compare, before one they take a byte
+		else if(accept("<"))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v < r;
+		}
+
+		else if(accept(">"))
+		{
+			if(!parseOr(r))
+				return false;
+			v = v > r;
+		}
+
+		else
+			return true;
+	}
+}
+
+bool expressions::parseOr(long& v)
+{
+	if(!parseXor(v))
+		return false;
+
+	long r;
+
+	while(accept("|"))
+	{
+		if(!parseXor(r))
+			return false;
+		v |= r;
+	}
+
+	return true;
+}
+
+bool expressions::parseXor(long& v)
+{
+	if(!parseAnd(v))
+		return false;
+
+	long r;
+
+	while(accept("^"))
+	{
+		if(!parseAnd(r))
+			return false;
+		v ^= r;
+	}
+
+	return true;
+}
+
+bool expressions::parseAnd(long& v)
+{
+	if(!parseShift(v))
+		return false;
+
+	long r;
+
+	while(accept("&"))
+	{
+		if(!parseShift(r))
+			return false;
+		v &= r;
+	}
+
+	return true;
+}
+
+bool expressions::parseShift(long& v)
+{
+	if(!parseAdd(v))
+		return false;
+
+	long r;
+
+	while(true)
+	{
+		if(accept("<<"))
+		{
+			if(!parseAdd(r))
+				return false;
+			v <<= r;
+		}
+
+		else if(accept(">>"))
+		{
+			if(!parseAdd(r))
+				return false;
+			v >>= r;
+		}
+
+		else
+			return true;
+	}
+}
+
+bool expressions::parseAdd(long& v)
+{
+	if(!parseMul(v))
+		return false;
+
+	long r;
+
+	while(true)
+	{
+		if(accept("+"))
+		{
+			if(!parseMul(r))
+				return false;
+			v += r;
+		}
+
+		else if(accept("-"))
+		{
+			if(!parseMul(r))
+				return false;
+			v -= r;
+		}
+
+		else
+			return true;
+	}
+}
+
+bool expressions::parseMul(long& v)
+{
+	if(!parseUnary(v))
+		return false;
+
+	long r;
+
+	while(true)
+	{
+		char op;
+
+		if(accept("*"))
+			op = '*';
+		else if(accept("/"))
+			op = '/';
+		else if(accept("%"))
+			op = '%';
+		else
+			return true;
+
+		if(!parseUnary(r))
+			return false;
+
+		if(op == '*')
+			v *= r;
+
+		else if(r == 0)
+		{
+			if(!undefined)
+				return fail("division by zero");
+			v = 0;
+		}
+
+		else if(op == '/')
+			v /= r;
+		else
+			v %= r;
+	}
+}
+
+bool expressions::parseUnary(long& v)
+{
+	if(accept("-"))
+	{
+		if(!parseUnary(v))
+			return false;
+		v = -v;
+	}
+
+	else if(accept("~"))
+	{
+		if(!parseUnary(v))
+			return false;
+		v = ~v;
+	}
+
+	else if(accept("<"))
+	{
+		if(!parseUnary(v))
+			return false;
+		v &= 0xFF;
+	}
+
+	else if(accept(">"))
+	{
+		if(!parseUnary(v))
+			return false;
+		v = (v >> 8) & 0xFF;
+	}
+
+	else
+		return parsePrimary(v);
+
+	return true;
+}
+
+bool expressions::parsePrimary(long& v)
+{
+	skipSpaces();
+
+	if(pos >= text.length())
+		return fail("missing operand");
+
+	char c = text[pos];
+
+	if(accept("("))
+	{
+		if(!parseCompare(v))
+			return false;
+		if(!accept(")"))
+			return fail("missing )");
+		return true;
+	}
+
+	if(c == '$' || c == '%' || (c >= '0' && c <= '9'))
+	{
+		int base = c == '$' ? 16 : c == '%' ? 2 : 10;
+		size_t start = c == '$' || c == '%' ? pos+1 : pos;
+		size_t end = start;
+
+		while(end < text.length() && (base == 16 ? isxdigit(text[end]) : base == 10 ? isdigit(text[end]) : (text[end] == '0' || text[end] == '1')))
+			end++;
+
+		if(end == start)
+			return fail("bad number");
+
+		try
+		{
+			v = std::stol(text.substr(start, end-start), 0, base);
+		}
+
+		catch(std::exception&)
+		{
+			return fail("bad number " + text.substr(pos, end-pos));
+		}
+
+		pos = end;
+		return true;
+	}
+
+	if(isalpha(c) || c == '_' || c == '@' || c == '.')
+	{
+		size_t end = pos;
+
+		while(end < text.length() && (isalnum(text[end]) || text[end] == '_' || text[end] == '@' || text[end] == '.'))
+			end++;
+
+		std::string name = text.substr(pos, end-pos);
+		pos = end;
+
+		if(accept("("))
+		{
+			std::vector<long> args;
+			long a;
+
+			if(!accept(")"))
+			{
+				do
+				{
+					if(!parseCompare(a))
+						return false;
+					args.push_back(a);
+				}
+				while(accept(","));
+
+				if(!accept(")"))
+					return fail("missing ) after arguments of " + name);
+			}
+
+			return callFunction(name, args, v);
+		}
+
+		auto s = syms->find(name);
+
+		if(s == syms->end())
+		{
+			// keep going so getNames() sees every symbol
+			names.push_back(name);
+			fail("undefined symbol " + name);
+			undefined = true;
+			v = 0;
+			return true;
+		}
+
+		names.push_back(name);
+		v = s->second;
+		return true;
+	}
+
+	return fail("unexpected '" + std::string(1, c) + "'");
+}
+
+bool expressions::callFunction(std::string name, std::vector<long> args, long& v)
+{
+	auto need = [&](size_t n) -> bool
+	{
+		if(args.size() != n)
+			return fail(name + " takes " + std::to_string(n) + " arguments");
+		return true;
+	};
+
+	// an undefined argument already failed the expression
+	if(undefined)
+	{
+		v = 0;
+		return true;
+	}
+
+	if(name == "sin" || name == "cos")
+	{
+		// sin(x, period, amplitude)
+		if(!need(3))
+			return false;
+		if(args[1] == 0)
+			return fail("zero period");
+
+		double a = 2 * M_PI * args[0] / args[1];
+		v = std::lround(args[2] * (name == "sin" ? std::sin(a) : std::cos(a)));
+	}
+
+	else if(name == "mul")
+	{
+		if(!need(2))
+			return false;
+		v = args[0] * args[1];
+	}
+
+	else if(name == "div")
+	{
+		// rounded to nearest, for reciprocal and scaling tables
+		if(!need(2))
+			return false;
+		if(args[1] == 0)
+			return fail("division by zero");
+		v = std::lround((double)args[0] / args[1]);
+	}
+
+	else if(name == "sqr")
+	{
+		if(!need(1))
+			return false;
+		v = args[0] * args[0];
+	}
+
+	else if(name == "lo")
+	{
+		if(!need(1))
+			return false;
+		v = args[0] & 0xFF;
+	}
+
+	else if(name == "hi")
+	{
+		if(!need(1))
+			return false;
+		v = (args[0] >> 8) & 0xFF;
+	}
+
+	else if(name == "min" || name == "max")
+	{
+		if(!need(2))
+			return false;
+		v = name == "min" ? std::min(args[0], args[1]) : std::max(args[0], args[1]);
+	}
+
+	else
+		return fail("unknown function " + name);
+
+	return true;
+}
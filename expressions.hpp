@@ -0,0 +1,44 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+// assemble-time constant expressions:
+// == != < > <= >= | ^ & << >> + - * / % unary - ~ < (low byte) > (high byte),
+// parentheses, $hex %bin decimal numbers, symbols and sin cos mul div sqr lo hi min max
+class expressions
+{
+public:
+	bool evaluate(std::string expr, std::map<std::string, size_t>& symbols, long& value);
+
+	// symbols referenced by expr, in order of appearance
+	std::vector<std::string> getNames(std::string expr);
+	// symbols referenced by the last evaluate()
+	const std::vector<std::string>& getLastNames();
+
+	std::string getError();
+	bool isUndefined();
+private:
+	std::string text;
+	size_t pos;
+	std::map<std::string, size_t>* syms;
+	std::string error;
+	bool undefined;
+	std::vector<std::string> names;
+
+	bool fail(std::string err);
+	void skipSpaces();
+	bool accept(std::string tok);
+
+	bool parseCompare(long& v);
+	bool parseOr(long& v);
+	bool parseXor(long& v);
+	bool parseAnd(long& v);
+	bool parseShift(long& v);
+	bool parseAdd(long& v);
+	bool parseMul(long& v);
+	bool parseUnary(long& v);
+	bool parsePrimary(long& v);
+	bool callFunction(std::string name, std::vector<long> args, long& v);
+};
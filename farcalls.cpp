@@ -0,0 +1,203 @@
+#include "farcalls.hpp"
+
+#include <iomanip>
+
+void farcalls::setBankSize(size_t size)
+{
+	bank_size = size;
+}
+
+void farcalls::addBank(size_t bank, size_t window)
+{
+	windows[bank] = window;
+}
+
+void farcalls::addLabel(std::string name, size_t bank)
+{
+	label_banks[name] = bank;
+}
+
+bool farcalls::isFixed(size_t bank)
+{
+	for(auto& w : windows)
+		if(w.first != bank && overlaps(w.first, bank))
+			return false;
+
+	return true;
+}
+
+std::string farcalls::route(std::string mnemonic, std::string target, size_t bank)
+{
+	auto f = label_banks.find(target);
+
+	if(f == label_banks.end() || f->second == bank || isFixed(f->second))
+		return "";
+
+	long restore = mnemonic == "JSR" && overlaps(bank, f->second) ? bank : -1;
+	std::string name = "__far_" + target + (restore < 0 ? "" : "_" + std::to_string(restore));
+
+	auto& t = trampolines[name];
+
+	if(t.calls++ == 0)
+	{
+		t.name = name;
+		t.target = target;
+		t.bank = f->second;
+		t.restore = restore;
+	}
+
+	return name;
+}
+
+bool farcalls::empty()
+{
+	return trampolines.empty();
+}
+
+bool farcalls::setMapper(int number)
+{
+	mapper = number;
+
+	if(mapper == 1 || mapper == 2 || mapper == 4)
+		return true;
+
+	error = "no bank switch template for mapper " + std::to_string(number);
+	return false;
+}
+
+bool farcalls::generate(std::vector<std::string>& lines)
+{
+	for(auto& i : trampolines)
+	{
+		auto& t = i.second;
+		std::vector<std::string> code;
+
+		if(!switchTo(t.bank, code))
+			return false;
+
+		if(t.restore < 0)
+			code.push_back("JMP " + t.target);
+
+		else
+		{
+			code.push_back("JSR " + t.target);
+			// A may hold what the target returns
+			code.push_back("PHA");
+
+			if(!switchTo(t.restore, code))
+				return false;
+
+			code.push_back("PLA");
+			code.push_back("RTS");
+		}
+
+		t.cycles = countCycles(code);
+
+		lines.push_back(t.name + ":");
+		lines.insert(lines.end(), code.begin(), code.end());
+	}
+
+	// UxROM has bus conflicts: the written byte has to be in ROM at the address
+	if(mapper == 2 && !trampolines.empty())
+	{
+		std::string table = "";
+
+		for(size_t b(0); b <= windows.rbegin()->first * bank_size / UXROM_BANK_UNIT; b++)
+			table += (b ? ", " : "") + std::to_string(b);
+
+		lines.push_back("__far_banks:");
+		lines.push_back(".db " + table);
+	}
+
+	return true;
+}
+
+std::string farcalls::makeReport()
+{
+	std::stringstream r;
+
+	r << "; sfotasm trampolines\n";
+	r << "; mapper " << mapper << ", cycles are added to every call\n";
+	r << std::left << std::setw(32) << "name" << std::setw(24) << "target";
+	r << std::setw(6) << "bank" << std::setw(7) << "calls" << "cycles\n";
+
+	for(auto& i : trampolines)
+	{
+		auto& t = i.second;
+
+		r << std::setw(32) << t.name << std::setw(24) << t.target << std::setw(6) << t.bank;
+		r << std::setw(7) << t.calls << t.cycles << "\n";
+	}
+
+	return r.str();
+}
+
+std::string farcalls::getError()
+{
+	return error;
+}
+
+bool farcalls::overlaps(size_t a, size_t b)
+{
+	return windows[a] < windows[b] + bank_size && windows[b] < windows[a] + bank_size;
+}
+
+bool farcalls::switchTo(size_t bank, std::vector<std::string>& lines)
+{
+	if(mapper == 2)
+	{
+		std::string n = std::to_string(bank * bank_size / UXROM_BANK_UNIT);
+
+		lines.push_back("LDA #" + n);
+		lines.push_back("STA __far_banks+" + n);
+	}
+
+	else if(mapper == 1)
+	{
+		// five serial writes to the PRG bank register, low bit first
+		lines.push_back("LDA #" + std::to_string(bank * bank_size / MMC1_BANK_UNIT));
+		lines.push_back("STA $E000");
+
+		for(size_t i(0); i < 4; i++)
+		{
+			lines.push_back("LSR A");
+			lines.push_back("STA $E000");
+		}
+	}
+
+	else
+	{
+		// R6 maps $8000, R7 $A000 (PRG mode 0)
+		size_t window = windows[bank];
+
+		if(window != 0x8000 && window != 0xA000)
+		{
+			error = "bank " + std::to_string(bank) + " is not at $8000 or $A000";
+			return false;
+		}
+
+		lines.push_back(window == 0x8000 ? "LDA #6" : "LDA #7");
+		lines.push_back("STA $8000");
+		lines.push_back("LDA #" + std::to_string(bank * bank_size / MMC3_BANK_UNIT));
+		lines.push_back("STA $8001");
+	}
+
+	return true;
+}
+
+size_t farcalls::countCycles(const std::vector<std::string>& lines)
+{
+	size_t cycles = 0;
+
+	for(auto& l : lines)
+	{
+		auto res = inst.parseInstruction(l);
+
+		if(res[0] == LABEL_CALL_SIGN || res[0] == LABEL_IMM_SIGN || res[0] == LABEL_ZP_SIGN)
+			cycles += codes.getOpcodeInfo(std::stoi(res[2], 0, 16)).cycles;
+		else
+			cycles += codes.getOpcodeInfo(std::stoi(res[0], 0, 16)).cycles;
+	}
+
+	return cycles;
+}
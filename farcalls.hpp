@@ -0,0 +1,64 @@
+#pragma once
+
+#include "instructions.hpp"
+
+// PRG bank units the mappers switch
+const size_t UXROM_BANK_UNIT = 0x4000;
+const size_t MMC1_BANK_UNIT = 0x4000;
+const size_t MMC3_BANK_UNIT = 0x2000;
+
+struct trampoline
+{
+	std::string name;
+	std::string target;
+	size_t bank;
+	// bank mapped again after the call returns, -1 when the trampoline
+	// jumps to the target and the target returns to the caller
+	long restore;
+	size_t calls;
+	size_t cycles;
+};
+
+// JSR/JMP into a bank that shares its window with other banks goes through a
+// trampoline in a fixed bank, which maps the target bank with the switch
+// sequence of the mapper (UxROM, MMC1, MMC3) first. The caller's bank is
+// mapped again after the call only when the target bank replaces it
+class farcalls
+{
+public:
+	void setBankSize(size_t size);
+	void addBank(size_t bank, size_t window);
+	void addLabel(std::string name, size_t bank);
+
+	// no other bank shares its window
+	bool isFixed(size_t bank);
+
+	// trampoline for a JSR or JMP to target from bank, "" when the call
+	// doesn't need one
+	std::string route(std::string mnemonic, std::string target, size_t bank);
+	bool empty();
+
+	// iNES mapper number, false when there is no template for it
+	bool setMapper(int number);
+
+	// source lines of all trampolines, false when one can't be made
+	bool generate(std::vector<std::string>& lines);
+	std::string makeReport();
+	std::string getError();
+private:
+	size_t bank_size = 0x2000;
+	std::map<size_t, size_t> windows;
+	std::map<std::string, size_t> label_banks;
+	std::map<std::string, trampoline> trampolines;
+
+	int mapper = 0;
+	std::string error;
+
+	instructions inst;
+	opcodes codes;
+
+	bool overlaps(size_t a, size_t b);
+	// lines that map bank
+	bool switchTo(size_t bank, std::vector<std::string>& lines);
+	size_t countCycles(const std::vector<std::string>& lines);
+};
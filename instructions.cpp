@@ -38,146 +38,147 @@ std::vector<std::string> instructions::parseKeyword(std::vector<std::string> ins
 	std::string name = instruction[0];
 	std::vector<std::string> code;
 
-	if(instruction.size() == 1)
+	// operands may contain spaces inside expressions
+	std::string op = "";
+
+	for(size_t i(1); i < instruction.size(); i++)
+		op += instruction[i];
+
+	std::string up = op;
+
+	for(auto& c : up)
+		c = ::toupper(c);
+
+	if(op == "" || (up == "A" && (name == "ASL" || name == "LSR" || name == "ROL" || name == "ROR")))
 	{
 		code.push_back(codes.getOpcode(name, OPCODE_TYPE::IMPLIED));
+		return code;
 	}
 
-	if(instruction.size() == 2)
+	size_t len = op.length();
+	OPCODE_TYPE tp = OPCODE_TYPE::ABS;
+
+	if(op[0] == '(' && len > 4 && up.compare(len-3, 3, ",X)") == 0)
 	{
-		std::string op = instruction[1];
-		OPERAND_TYPE tp = getOperandType(op);
+		tp = OPCODE_TYPE::INDX;
+		op = op.substr(1, len-4);
+	}
 
-		switch(tp)
-		{
-			case NUMBER:
-			{
-				op = convertToHex(op, isNumber(op), false);
-
-				while(op.length() < 2)
-					op = '0' + op;
-
-				code.push_back(codes.getOpcode(name, OPCODE_TYPE::IMM));
-				code.push_back(op);
-				break;
-			}
-
-			case ADDRESS:
-			{
-				op = convertToHex(op, isNumber('#'+op), true);
-
-				if(codes.isRelativeKeyword(name))
-					return {RELATIVE_ADDR_SIGN, op, codes.getOpcode(name, OPCODE_TYPE::IMPLIED)};
-
-				std::string low = std::string(1, op[0]) + std::string(1, op[1]);
-				std::string high = std::string(1, op[2]) + std::string(1, op[3]);
-
-				code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABS));
-				code.push_back(high);
-				code.push_back(low);
-				break;
-			}
-
-			case LABEL:
-			{
-				if(codes.isRelativeKeyword(name))
-					return {RELATIVE_SIGN, op, codes.getOpcode(name, OPCODE_TYPE::IMPLIED)};
-
-				code.push_back(LABEL_CALL_SIGN);
-				code.push_back(op);
-				code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABS));
-				break;
-			}
-		}
+	else if(op[0] == '(' && len > 4 && up.compare(len-3, 3, "),Y") == 0)
+	{
+		tp = OPCODE_TYPE::INDY;
+		op = op.substr(1, len-4);
 	}
 
-	if(instruction.size() == 3)
+	else if(len > 2 && up.compare(len-2, 2, ",X") == 0)
 	{
-		std::string op = instruction[1];
-		std::string reg = instruction[2];
+		tp = OPCODE_TYPE::ABSX;
+		op = op.substr(0, len-2);
+	}
 
-		if(op[op.length()-1] == ',')
-		{
-			op.pop_back();
-			OPERAND_TYPE tp = getOperandType(op);
-
-			if(tp == OPERAND_TYPE::ADR_INDY && reg == "Y")
-			{
-				op.pop_back(); // )
-				op.erase(op.begin());
-				op = convertToHex(op, isNumber('#'+op), true);
-
-				std::string low = std::string(1, op[0]) + std::string(1, op[1]);
-				std::string high = std::string(1, op[2]) + std::string(1, op[3]);
-
-				code.push_back(codes.getOpcode(name, OPCODE_TYPE::INDY));
-				code.push_back(high);
-				code.push_back(low);
-
-				return code;
-			}
-
-			else if(tp == OPERAND_TYPE::ADR_INDX && reg == "X)")
-			{	
-				op.erase(op.begin());
-				op = convertToHex(op, isNumber('#'+op), true);
-
-				std::string low = std::string(1, op[0]) + std::string(1, op[1]);
-				std::string high = std::string(1, op[2]) + std::string(1, op[3]);
-
-				code.push_back(codes.getOpcode(name, OPCODE_TYPE::INDX));
-				code.push_back(high);
-				code.push_back(low);
-
-				return code;
-			}
-
-			else if(tp == OPERAND_TYPE::ADDRESS)
-			{
-				op = convertToHex(op, isNumber('#'+op), true);
-
-				std::string low = std::string(1, op[0]) + std::string(1, op[1]);
-				std::string high = std::string(1, op[2]) + std::string(1, op[3]);
-
-				if(reg == "X" || reg == "x")
-				{
-					code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABSX));
-					code.push_back(high);
-					code.push_back(low);
-				}
-
-				else if(reg == "Y" || reg == "y")
-				{
-					code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABSY));
-					code.push_back(high);
-					code.push_back(low);
-				}
-			}
-
-			else if(tp == OPERAND_TYPE::LABEL)
-			{
-				code.push_back(LABEL_CALL_SIGN);
-				code.push_back(op);
-				if(reg == "X" || reg == "x")
-				{
-					code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABSX));
-				}
-				else
-				{
-					code.push_back(codes.getOpcode(name, OPCODE_TYPE::ABSY));
-				}
-
-				return code;
-			}
-
-			else
-				return {ERROR_ILLEGAL_OPERAND_SIGN};
-		}
+	else if(len > 2 && up.compare(len-2, 2, ",Y") == 0)
+	{
+		tp = OPCODE_TYPE::ABSY;
+		op = op.substr(0, len-2);
+	}
+
+	else if(op[0] == '#')
+	{
+		tp = OPCODE_TYPE::IMM;
+		op.erase(op.begin());
+	}
+
+	else if(name == "JMP" && op[0] == '(' && op[len-1] == ')')
+	{
+		tp = OPCODE_TYPE::IND;
+		op = op.substr(1, len-2);
+	}
+
+	bool relative = codes.isRelativeKeyword(name);
+
+	if(relative && tp != OPCODE_TYPE::ABS)
+		return {ERROR_ILLEGAL_OPERAND_SIGN};
+
+	// the table keeps relative branches and JMP (ind) in the implied column
+	std::string opc = codes.getOpcode(name, relative || tp == OPCODE_TYPE::IND ? OPCODE_TYPE::IMPLIED : tp);
+
+	if(opc == ERROR_ILLEGAL_OPERAND_SIGN)
+		return {ERROR_ILLEGAL_OPERAND_SIGN};
+
+	if(op == "")
+		return {ERROR_ILLEGAL_OPERAND_SIGN};
+
+	bool byte = tp == OPCODE_TYPE::IMM || tp == OPCODE_TYPE::INDX || tp == OPCODE_TYPE::INDY;
+	NUM_TYPE num = isNumber('#'+op);
+
+	// labels and expressions are resolved in pass 2, numbers too large for
+	// the operand as well so the range check reports them, and binary ones
+	// past 8 bits, which convertToHex can't take
+	if(num == NUM_TYPE::NAN || literalValue(op) > (byte || num == NUM_TYPE::BIN_NUM ? 0xFFu : 0xFFFFu))
+	{
+		if(tp == OPCODE_TYPE::IMM)
+			return {LABEL_IMM_SIGN, op, opc};
+		if(tp == OPCODE_TYPE::INDX || tp == OPCODE_TYPE::INDY)
+			return {LABEL_ZP_SIGN, op, opc};
+		if(relative)
+			return {RELATIVE_SIGN, op, opc};
+		return {LABEL_CALL_SIGN, op, opc};
+	}
+
+	if(tp == OPCODE_TYPE::IMM)
+	{
+		op = convertToHex('#'+op, isNumber('#'+op), false);
+
+		while(op.length() < 2)
+			op = '0' + op;
+
+		code.push_back(opc);
+		code.push_back(op);
+		return code;
+	}
+
+	op = convertToHex(op, isNumber('#'+op), true);
+
+	if(relative)
+		return {RELATIVE_ADDR_SIGN, op, opc};
+
+	std::string low = std::string(1, op[0]) + std::string(1, op[1]);
+	std::string high = std::string(1, op[2]) + std::string(1, op[3]);
+
+	code.push_back(opc);
+
+	if(tp == OPCODE_TYPE::INDX || tp == OPCODE_TYPE::INDY)
+	{
+		// indirect pointers live in zero page
+		if(low != "00")
+			return {ERROR_ILLEGAL_OPERAND_SIGN};
+
+		code.push_back(high);
+		return code;
 	}
 
+	code.push_back(high);
+	code.push_back(low);
+
 	return code;
 }
 
+unsigned long long instructions::literalValue(std::string op)
+{
+	NUM_TYPE tp = isNumber('#'+op);
+	std::string digits = tp == NUM_TYPE::DEC_NUM ? op : op.substr(1);
+
+	digits.erase(0, digits.find_first_not_of('0'));
+
+	if(digits == "")
+		return 0;
+
+	if(digits.length() > 16)
+		return ~0ull;
+
+	return std::stoull(digits, 0, tp == NUM_TYPE::HEX_NUM ? 16 : tp == NUM_TYPE::BIN_NUM ? 2 : 10);
+}
+
 NUM_TYPE instructions::isNumber(std::string op)
 {
 	if(op[0] != '#')
@@ -201,7 +202,10 @@ NUM_TYPE instructions::isNumber(std::string op)
 
 	else
 	{
-		for(int i(2); i < op.size(); i++)
+		if(op.size() < 2)
+			return NUM_TYPE::NAN;
+
+		for(int i(1); i < op.size(); i++)
 			if(!((op[i] >= '0' && op[i] <= '9')))
 				return NUM_TYPE::NAN;
 		return NUM_TYPE::DEC_NUM;
@@ -289,4 +293,9 @@ std::string instructions::convertToHex(std::string num, NUM_TYPE tp, bool is_add
 void instructions::addIllegalOpcodes()
 {
 	codes.initIllegalOpcodes();
+}
+
+std::string instructions::getZeroPageOpcode(std::string abs)
+{
+	return codes.getZeroPageOpcode(abs);
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+#pragma once
+
 #include "opcodes.hpp"
 
 #include <sstream>
@@ -26,6 +28,8 @@ enum OPERAND_TYPE
 const std::string LABEL_SIGN = "l"; 
 const std::string COMMENT_SIGN = ";"; 
 const std::string LABEL_CALL_SIGN = "lc";
+const std::string LABEL_IMM_SIGN = "li";
+const std::string LABEL_ZP_SIGN = "lz";
 const std::string JMP_SIGN = "j";
 const std::string RELATIVE_SIGN = "rl";
 const std::string RELATIVE_ADDR_SIGN = "ral";
@@ -45,8 +49,13 @@ public:
 	std::string convertToHex(std::string num, NUM_TYPE tp, bool is_addr);
 
 	void addIllegalOpcodes();
+
+	// zero page form of an absolute opcode, "" when there is none
+	std::string getZeroPageOpcode(std::string abs);
 private:
 	opcodes codes;
 
 	std::vector<std::string> parseKeyword(std::vector<std::string> instruction);
+	// value of a number without #, past 16 digits as good as infinite
+	unsigned long long literalValue(std::string op);
 };
\ No newline at end of file
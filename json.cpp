@@ -0,0 +1,411 @@
+#include "json.hpp"
+
+#include <cstdlib>
+#include <cstring>
+
+json::json() : type(NUL)
+{
+}
+
+json::json(bool b) : type(BOOL), boolean(b)
+{
+}
+
+json::json(int n) : type(NUMBER), number(n)
+{
+}
+
+json::json(long n) : type(NUMBER), number(n)
+{
+}
+
+json::json(size_t n) : type(NUMBER), number(n)
+{
+}
+
+json::json(double n) : type(NUMBER), number(n)
+{
+}
+
+json::json(const char* s) : type(STRING), str(s)
+{
+}
+
+json::json(std::string s) : type(STRING), str(s)
+{
+}
+
+json json::array()
+{
+	json v;
+	v.type = ARRAY;
+	return v;
+}
+
+json json::object()
+{
+	json v;
+	v.type = OBJECT;
+	return v;
+}
+
+json::value_type json::getType() const
+{
+	return type;
+}
+
+bool json::isNull() const
+{
+	return type == NUL;
+}
+
+bool json::getBool() const
+{
+	return type == BOOL && boolean;
+}
+
+long json::getNumber() const
+{
+	return type == NUMBER ? (long)number : 0;
+}
+
+const std::string& json::getString() const
+{
+	return str;
+}
+
+bool json::has(std::string key) const
+{
+	return members.find(key) != members.end();
+}
+
+const json& json::operator[](std::string key) const
+{
+	static const json none;
+	auto f = members.find(key);
+
+	return f == members.end() ? none : f->second;
+}
+
+json& json::operator[](std::string key)
+{
+	type = OBJECT;
+	return members[key];
+}
+
+size_t json::size() const
+{
+	return type == ARRAY ? items.size() : members.size();
+}
+
+const json& json::at(size_t i) const
+{
+	return items[i];
+}
+
+void json::push(json value)
+{
+	type = ARRAY;
+	items.push_back(value);
+}
+
+std::string json::dump() const
+{
+	std::string out;
+	dump(out);
+	return out;
+}
+
+void json::dump(std::string& out) const
+{
+	switch(type)
+	{
+		case NUL:
+			out += "null";
+			break;
+		case BOOL:
+			out += boolean ? "true" : "false";
+			break;
+		case NUMBER:
+			if(number == (long)number)
+				out += std::to_string((long)number);
+			else
+				out += std::to_string(number);
+			break;
+		case STRING:
+			dumpString(str, out);
+			break;
+		case ARRAY:
+			out += '[';
+			for(size_t i(0); i < items.size(); i++)
+			{
+				if(i)
+					out += ',';
+				items[i].dump(out);
+			}
+			out += ']';
+			break;
+		case OBJECT:
+			out += '{';
+			for(auto m = members.begin(); m != members.end(); m++)
+			{
+				if(m != members.begin())
+					out += ',';
+				dumpString(m->first, out);
+				out += ':';
+				m->second.dump(out);
+			}
+			out += '}';
+			break;
+	}
+}
+
+void json::dumpString(const std::string& s, std::string& out)
+{
+	static const char digits[] = "0123456789abcdef";
+
+	out += '"';
+
+	for(unsigned char c : s)
+	{
+		if(c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if(c == '\n')
+			out += "\\n";
+		else if(c == '\t')
+			out += "\\t";
+		else if(c == '\r')
+			out += "\\r";
+		else if(c < 0x20)
+		{
+			out += "\\u00";
+			out += digits[c >> 4];
+			out += digits[c & 0xF];
+		}
+		else
+			out += c;
+	}
+
+	out += '"';
+}
+
+bool json::parse(const std::string& text, json& value)
+{
+	size_t pos = 0;
+
+	if(!parseValue(text, pos, value))
+		return false;
+
+	skipSpaces(text, pos);
+	return pos == text.length();
+}
+
+void json::skipSpaces(const std::string& text, size_t& pos)
+{
+	while(pos < text.length() && strchr(" \t\r\n", text[pos]))
+		pos++;
+}
+
+bool json::parseValue(const std::string& text, size_t& pos, json& value)
+{
+	skipSpaces(text, pos);
+
+	if(pos >= text.length())
+		return false;
+
+	char c = text[pos];
+
+	if(c == '{')
+	{
+		value = object();
+		pos++;
+		skipSpaces(text, pos);
+
+		if(pos < text.length() && text[pos] == '}')
+		{
+			pos++;
+			return true;
+		}
+
+		while(true)
+		{
+			std::string key;
+
+			skipSpaces(text, pos);
+
+			if(!parseString(text, pos, key))
+				return false;
+
+			skipSpaces(text, pos);
+
+			if(pos >= text.length() || text[pos++] != ':')
+				return false;
+
+			if(!parseValue(text, pos, value.members[key]))
+				return false;
+
+			skipSpaces(text, pos);
+
+			if(pos >= text.length())
+				return false;
+
+			if(text[pos] == '}')
+			{
+				pos++;
+				return true;
+			}
+
+			if(text[pos++] != ',')
+				return false;
+		}
+	}
+
+	if(c == '[')
+	{
+		value = array();
+		pos++;
+		skipSpaces(text, pos);
+
+		if(pos < text.length() && text[pos] == ']')
+		{
+			pos++;
+			return true;
+		}
+
+		while(true)
+		{
+			json item;
+
+			if(!parseValue(text, pos, item))
+				return false;
+
+			value.items.push_back(item);
+			skipSpaces(text, pos);
+
+			if(pos >= text.length())
+				return false;
+
+			if(text[pos] == ']')
+			{
+				pos++;
+				return true;
+			}
+
+			if(text[pos++] != ',')
+				return false;
+		}
+	}
+
+	if(c == '"')
+	{
+		value = json("");
+		return parseString(text, pos, value.str);
+	}
+
+	if(text.compare(pos, 4, "true") == 0)
+	{
+		value = json(true);
+		pos += 4;
+		return true;
+	}
+
+	if(text.compare(pos, 5, "false") == 0)
+	{
+		value = json(false);
+		pos += 5;
+		return true;
+	}
+
+	if(text.compare(pos, 4, "null") == 0)
+	{
+		value = json();
+		pos += 4;
+		return true;
+	}
+
+	char* end;
+	double n = strtod(text.c_str() + pos, &end);
+
+	if(end == text.c_str() + pos)
+		return false;
+
+	value = json(n);
+	pos = end - text.c_str();
+	return true;
+}
+
+bool json::parseString(const std::string& text, size_t& pos, std::string& s)
+{
+	if(pos >= text.length() || text[pos] != '"')
+		return false;
+
+	for(pos++; pos < text.length(); pos++)
+	{
+		char c = text[pos];
+
+		if(c == '"')
+		{
+			pos++;
+			return true;
+		}
+
+		if(c != '\\')
+		{
+			s += c;
+			continue;
+		}
+
+		if(++pos >= text.length())
+			return false;
+
+		switch(text[pos])
+		{
+			case 'n':
+				s += '\n';
+				break;
+			case 't':
+				s += '\t';
+				break;
+			case 'r':
+				s += '\r';
+				break;
+			case 'b':
+				s += '\b';
+				break;
+			case 'f':
+				s += '\f';
+				break;
+			case 'u':
+			{
+				if(pos+4 >= text.length())
+					return false;
+
+				unsigned long u = std::strtoul(text.substr(pos+1, 4).c_str(), nullptr, 16);
+				pos += 4;
+
+				// as UTF-8, surrogate pairs are kept as two characters
+				if(u < 0x80)
+					s += (char)u;
+				else if(u < 0x800)
+				{
+					s += (char)(0xC0 | (u >> 6));
+					s += (char)(0x80 | (u & 0x3F));
+				}
+				else
+				{
+					s += (char)(0xE0 | (u >> 12));
+					s += (char)(0x80 | ((u >> 6) & 0x3F));
+					s += (char)(0x80 | (u & 0x3F));
+				}
+				break;
+			}
+			default:
+				s += text[pos];
+		}
+	}
+
+	return false;
+}
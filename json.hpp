@@ -0,0 +1,67 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+// JSON values of LSP messages
+class json
+{
+public:
+	enum value_type
+	{
+		NUL,
+		BOOL,
+		NUMBER,
+		STRING,
+		ARRAY,
+		OBJECT
+	};
+
+	json();
+	json(bool b);
+	json(int n);
+	json(long n);
+	json(size_t n);
+	json(double n);
+	json(const char* s);
+	json(std::string s);
+
+	static json array();
+	static json object();
+
+	value_type getType() const;
+	bool isNull() const;
+
+	bool getBool() const;
+	long getNumber() const;
+	const std::string& getString() const;
+
+	// members, a missing one reads as null
+	bool has(std::string key) const;
+	const json& operator[](std::string key) const;
+	json& operator[](std::string key);
+
+	size_t size() const;
+	const json& at(size_t i) const;
+	void push(json value);
+
+	std::string dump() const;
+
+	// false on malformed text
+	static bool parse(const std::string& text, json& value);
+private:
+	value_type type;
+	bool boolean = false;
+	double number = 0;
+	std::string str;
+	std::vector<json> items;
+	std::map<std::string, json> members;
+
+	void dump(std::string& out) const;
+	static void dumpString(const std::string& s, std::string& out);
+
+	static bool parseValue(const std::string& text, size_t& pos, json& value);
+	static bool parseString(const std::string& text, size_t& pos, std::string& s);
+	static void skipSpaces(const std::string& text, size_t& pos);
+};
@@ -0,0 +1,154 @@
+; LZ4 block decompressor for data packed by .incbin/.compress with compress=lz4
+;
+; zero page: .rsset to free space before the .include
+; in: lz4_src - packed data (as placed by the assembler), lz4_dst - RAM
+; JSR lz4_unpack
+; uses A, Y
+
+lz4_src .rs 2
+lz4_dst .rs 2
+lz4_end .rs 2
+lz4_from .rs 2
+lz4_len .rs 2
+lz4_token .rs 1
+
+lz4_unpack:
+	; lz4_end = lz4_dst + unpacked size
+	JSR lz4_get
+	CLC
+	ADC lz4_dst
+	STA lz4_end
+	JSR lz4_get
+	ADC lz4_dst+1
+	STA lz4_end+1
+
+lz4_sequence:
+	JSR lz4_get
+	STA lz4_token
+
+	; literals, copied straight from the source
+	LSR A
+	LSR A
+	LSR A
+	LSR A
+	JSR lz4_length
+
+	LDA lz4_src
+	STA lz4_from
+	LDA lz4_src+1
+	STA lz4_from+1
+	JSR lz4_copy
+	LDA lz4_from
+	STA lz4_src
+	LDA lz4_from+1
+	STA lz4_src+1
+
+	; the last sequence has no match
+	LDA lz4_dst
+	CMP lz4_end
+	BNE lz4_match
+	LDA lz4_dst+1
+	CMP lz4_end+1
+	BEQ lz4_done
+
+lz4_match:
+	; lz4_from = lz4_dst - offset
+	JSR lz4_get
+	STA lz4_len
+	JSR lz4_get
+	STA lz4_len+1
+	SEC
+	LDA lz4_dst
+	SBC lz4_len
+	STA lz4_from
+	LDA lz4_dst+1
+	SBC lz4_len+1
+	STA lz4_from+1
+
+	LDA lz4_token
+	AND #$0F
+	JSR lz4_length
+
+	; minimum match is 4
+	CLC
+	LDA lz4_len
+	ADC #4
+	STA lz4_len
+	BCC lz4_match_copy
+	INC lz4_len+1
+
+lz4_match_copy:
+	JSR lz4_copy
+	JMP lz4_sequence
+
+lz4_done:
+	RTS
+
+; lz4_len = A, plus the extra bytes that follow a 15
+lz4_length:
+	STA lz4_len
+	LDA #0
+	STA lz4_len+1
+	LDA lz4_len
+	CMP #15
+	BNE lz4_length_done
+
+lz4_length_more:
+	JSR lz4_get
+	PHA
+	CLC
+	ADC lz4_len
+	STA lz4_len
+	BCC lz4_length_next
+	INC lz4_len+1
+
+lz4_length_next:
+	PLA
+	CMP #255
+	BEQ lz4_length_more
+
+lz4_length_done:
+	RTS
+
+; lz4_len bytes from lz4_from to lz4_dst, both advance
+lz4_copy:
+	LDY #0
+
+lz4_copy_loop:
+	LDA lz4_len
+	ORA lz4_len+1
+	BEQ lz4_copy_done
+
+	LDA (lz4_from),Y
+	STA (lz4_dst),Y
+
+	INC lz4_from
+	BNE lz4_copy_dst
+	INC lz4_from+1
+
+lz4_copy_dst:
+	INC lz4_dst
+	BNE lz4_copy_count
+	INC lz4_dst+1
+
+lz4_copy_count:
+	LDA lz4_len
+	BNE lz4_copy_low
+	DEC lz4_len+1
+
+lz4_copy_low:
+	DEC lz4_len
+	JMP lz4_copy_loop
+
+lz4_copy_done:
+	RTS
+
+lz4_get:
+	LDY #0
+	LDA (lz4_src),Y
+	INC lz4_src
+	BNE lz4_get_done
+	INC lz4_src+1
+
+lz4_get_done:
+	RTS
@@ -0,0 +1,112 @@
+; LZSS decompressor for data packed by .incbin/.compress with compress=lzss
+;
+; zero page: .rsset to free space before the .include
+; in: lzss_src - packed data (as placed by the assembler), lzss_dst - RAM
+; JSR lzss_unpack
+; uses A, Y
+
+lzss_src .rs 2
+lzss_dst .rs 2
+lzss_end .rs 2
+lzss_from .rs 2
+lzss_off .rs 2
+lzss_len .rs 1
+lzss_flags .rs 1
+lzss_bits .rs 1
+
+lzss_unpack:
+	; lzss_end = lzss_dst + unpacked size
+	JSR lzss_get
+	CLC
+	ADC lzss_dst
+	STA lzss_end
+	JSR lzss_get
+	ADC lzss_dst+1
+	STA lzss_end+1
+
+lzss_next_flags:
+	JSR lzss_get
+	STA lzss_flags
+	LDA #8
+	STA lzss_bits
+
+lzss_item:
+	LDA lzss_dst
+	CMP lzss_end
+	BNE lzss_decode
+	LDA lzss_dst+1
+	CMP lzss_end+1
+	BEQ lzss_done
+
+lzss_decode:
+	LSR lzss_flags
+	BCC lzss_match
+
+	; literal
+	JSR lzss_get
+	LDY #0
+	STA (lzss_dst),Y
+	INC lzss_dst
+	BNE lzss_count
+	INC lzss_dst+1
+	JMP lzss_count
+
+lzss_match:
+	; offset bits 0-7, then bits 8-11 and length-3 in one byte
+	JSR lzss_get
+	STA lzss_off
+	JSR lzss_get
+	PHA
+	AND #$0F
+	CLC
+	ADC #3
+	STA lzss_len
+	PLA
+	LSR A
+	LSR A
+	LSR A
+	LSR A
+	STA lzss_off+1
+
+	SEC
+	LDA lzss_dst
+	SBC lzss_off
+	STA lzss_from
+	LDA lzss_dst+1
+	SBC lzss_off+1
+	STA lzss_from+1
+
+	; forward copy, overlapping matches repeat what was just written
+	LDY #0
+
+lzss_copy:
+	LDA (lzss_from),Y
+	STA (lzss_dst),Y
+	INY
+	CPY lzss_len
+	BNE lzss_copy
+
+	TYA
+	CLC
+	ADC lzss_dst
+	STA lzss_dst
+	BCC lzss_count
+	INC lzss_dst+1
+
+lzss_count:
+	DEC lzss_bits
+	BNE lzss_item
+	JMP lzss_next_flags
+
+lzss_done:
+	RTS
+
+lzss_get:
+	LDY #0
+	LDA (lzss_src),Y
+	INC lzss_src
+	BNE lzss_get_done
+	INC lzss_src+1
+
+lzss_get_done:
+	RTS
@@ -0,0 +1,84 @@
+; RLE decompressor for data packed by .incbin/.compress with compress=rle
+;
+; zero page: .rsset to free space before the .include
+; in: rle_src - packed data (as placed by the assembler), rle_dst - RAM
+; JSR rle_unpack     unpacks to RAM at rle_dst
+; JSR rle_unpack_ppu unpacks to $2007, set the PPU address first
+; uses A, Y
+
+rle_src .rs 2
+rle_dst .rs 2
+rle_count .rs 1
+rle_ppu .rs 1
+
+rle_unpack_ppu:
+	LDA #$80
+	STA rle_ppu
+	BNE rle_start
+
+rle_unpack:
+	LDA #0
+	STA rle_ppu
+
+rle_start:
+	; skip the unpacked size
+	JSR rle_get
+	JSR rle_get
+
+rle_next:
+	JSR rle_get
+	BEQ rle_done
+	BMI rle_run
+
+	; 1..127 literals
+	STA rle_count
+
+rle_literal:
+	JSR rle_get
+	JSR rle_put
+	DEC rle_count
+	BNE rle_literal
+	BEQ rle_next
+
+rle_run:
+	; 128..255: next byte repeated control-126 times
+	SEC
+	SBC #126
+	STA rle_count
+	JSR rle_get
+
+rle_repeat:
+	JSR rle_put
+	DEC rle_count
+	BNE rle_repeat
+	BEQ rle_next
+
+rle_done:
+	RTS
+
+rle_get:
+	LDY #0
+	LDA (rle_src),Y
+	INC rle_src
+	BNE rle_get_done
+	INC rle_src+1
+
+rle_get_done:
+	ORA #0
+	RTS
+
+rle_put:
+	BIT rle_ppu
+	BMI rle_put_ppu
+	LDY #0
+	STA (rle_dst),Y
+	INC rle_dst
+	BNE rle_put_done
+	INC rle_dst+1
+
+rle_put_done:
+	RTS
+
+rle_put_ppu:
+	STA $2007
+	RTS
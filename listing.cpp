@@ -0,0 +1,186 @@
+#include "listing.hpp"
+
+#include <cstring>
+
+listing::~listing()
+{
+	close();
+}
+
+bool listing::open(std::string filename)
+{
+	output.open(filename);
+	used = 0;
+	symbols.clear();
+
+	return output.good();
+}
+
+bool listing::isOpen()
+{
+	return output.is_open();
+}
+
+void listing::add(size_t address, size_t bank, const std::string& hex,
+	const std::string& file, size_t line, const std::string& text)
+{
+	size_t bytes = hex.length()/2;
+	size_t row = 0;
+
+	do
+	{
+		putHex(address + row, 4);
+		put("  ", 2);
+		putDec(bank, 3);
+		put("  ", 2);
+
+		size_t n = std::min(bytes - row, LISTING_BYTES_PER_ROW);
+
+		// continuation rows stop after their last byte
+		for(size_t i(0); i < (row == 0 ? LISTING_BYTES_PER_ROW : n); i++)
+		{
+			if(i < n)
+				put(hex.data() + (row+i)*2, 2);
+			else
+				put("  ", 2);
+			put(" ", 1);
+		}
+
+		if(row == 0)
+		{
+			put(" ", 1);
+			put(file);
+			put(":", 1);
+			putDec(line, 0);
+			put("\t", 1);
+			put(text);
+		}
+
+		put("\n", 1);
+		row += LISTING_BYTES_PER_ROW;
+	}
+	while(row < bytes);
+}
+
+void listing::define(std::string name, size_t address, const std::string& file, size_t line)
+{
+	symbol& s = symbols[name];
+
+	s.address = address;
+	s.defined = file + ":" + std::to_string(line);
+}
+
+void listing::reference(std::string name, const std::string& file, size_t line)
+{
+	auto& refs = symbols[name].refs;
+	std::string ref = file + ":" + std::to_string(line);
+
+	if(refs.empty() || refs.back() != ref)
+		refs.push_back(ref);
+}
+
+void listing::close()
+{
+	if(!output.is_open())
+		return;
+
+	put("\nSymbols\n\n");
+
+	for(auto& s : symbols)
+	{
+		// references to defines and table variables aren't labels
+		if(s.second.defined == "")
+			continue;
+
+		put(s.first);
+		pad(s.first.length() < 32 ? 32 - s.first.length() : 1);
+		put("$", 1);
+		putHex(s.second.address, 4);
+		put("  ", 2);
+		put(s.second.defined);
+
+		if(s.second.refs.size() > 0)
+			put("  used:");
+
+		for(auto& r : s.second.refs)
+		{
+			put(" ", 1);
+			put(r);
+		}
+
+		put("\n", 1);
+	}
+
+	flush();
+	output.close();
+}
+
+void listing::flush()
+{
+	output.write(buffer, used);
+	used = 0;
+}
+
+void listing::put(const char* s, size_t n)
+{
+	while(n > 0)
+	{
+		if(used == LISTING_BUFFER_SIZE)
+			flush();
+
+		size_t k = std::min(n, LISTING_BUFFER_SIZE - used);
+
+		memcpy(buffer + used, s, k);
+		used += k;
+		s += k;
+		n -= k;
+	}
+}
+
+void listing::put(const std::string& s)
+{
+	put(s.data(), s.length());
+}
+
+void listing::putHex(size_t v, size_t width)
+{
+	static const char digits[] = "0123456789ABCDEF";
+	char tmp[16];
+	size_t n = 0;
+
+	do
+	{
+		tmp[15 - n++] = digits[v & 0xF];
+		v >>= 4;
+	}
+	while(v && n < 16);
+
+	for(; n < width && n < 16; n++)
+		tmp[15 - n] = '0';
+
+	put(tmp + 16 - n, n);
+}
+
+void listing::putDec(size_t v, size_t width)
+{
+	char tmp[24];
+	size_t n = 0;
+
+	do
+	{
+		tmp[23 - n++] = '0' + v % 10;
+		v /= 10;
+	}
+	while(v);
+
+	for(; n < width; n++)
+		tmp[23 - n] = ' ';
+
+	put(tmp + 24 - n, n);
+}
+
+void listing::pad(size_t n)
+{
+	while(n--)
+		put(" ", 1);
+}
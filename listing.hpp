@@ -0,0 +1,51 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+const size_t LISTING_BUFFER_SIZE = 64*1024;
+const size_t LISTING_BYTES_PER_ROW = 4;
+
+// .lst writer: address, bank, bytes, file:line and source per row and a
+// symbol cross-reference at the end, formatted into a fixed buffer that is
+// flushed whenever it fills up
+class listing
+{
+public:
+	~listing();
+
+	bool open(std::string filename);
+	bool isOpen();
+
+	// hex bytes as emitted, long data continues on the following rows
+	void add(size_t address, size_t bank, const std::string& hex,
+		const std::string& file, size_t line, const std::string& text);
+
+	void define(std::string name, size_t address, const std::string& file, size_t line);
+	void reference(std::string name, const std::string& file, size_t line);
+
+	// writes the cross-reference and the rest of the buffer
+	void close();
+private:
+	struct symbol
+	{
+		size_t address;
+		std::string defined;
+		std::vector<std::string> refs;
+	};
+
+	std::ofstream output;
+	char buffer[LISTING_BUFFER_SIZE];
+	size_t used = 0;
+
+	std::map<std::string, symbol> symbols;
+
+	void flush();
+	void put(const char* s, size_t n);
+	void put(const std::string& s);
+	void putHex(size_t v, size_t width);
+	void putDec(size_t v, size_t width);
+	void pad(size_t n);
+};
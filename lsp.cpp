@@ -0,0 +1,561 @@
+#include "lsp.hpp"
+
+#include <filesystem>
+#include <cstring>
+
+lsp::lsp() : as(log, &cache)
+{
+}
+
+int lsp::run(std::istream& in, std::ostream& out)
+{
+	this->in = &in;
+	this->out = &out;
+
+	json msg;
+
+	while(!done && readMessage(msg))
+	{
+		handle(msg);
+
+		// a burst of edits is analyzed once, when no more input is waiting
+		if(in.rdbuf()->in_avail() > 0)
+			continue;
+
+		for(auto& d : docs)
+			if(d.second.dirty)
+				analyze(d.first, d.second);
+	}
+
+	return shutdown ? 0 : 1;
+}
+
+bool lsp::readMessage(json& msg)
+{
+	size_t length = 0;
+
+	for(std::string line; std::getline(*in, line);)
+	{
+		if(line != "" && line.back() == '\r')
+			line.pop_back();
+
+		if(line == "")
+		{
+			std::string body(length, ' ');
+
+			if(!in->read(&body[0], length))
+				return false;
+
+			// a malformed message is dropped
+			if(json::parse(body, msg))
+				return true;
+
+			length = 0;
+			continue;
+		}
+
+		if(line.compare(0, 15, "Content-Length:") == 0)
+		{
+			try
+			{
+				length = std::stoul(line.substr(15));
+			}
+
+			catch(const std::exception&)
+			{
+				replyError(json(), -32700, "bad Content-Length");
+				length = 0;
+			}
+		}
+	}
+
+	return false;
+}
+
+void lsp::send(json msg)
+{
+	msg["jsonrpc"] = "2.0";
+
+	std::string body = msg.dump();
+
+	*out << "Content-Length: " << body.length() << "\r\n\r\n" << body;
+	out->flush();
+}
+
+void lsp::reply(const json& id, json result)
+{
+	json msg;
+
+	msg["id"] = id;
+	msg["result"] = result;
+	send(msg);
+}
+
+void lsp::replyError(const json& id, int code, std::string message)
+{
+	json msg;
+
+	msg["id"] = id;
+	msg["error"]["code"] = code;
+	msg["error"]["message"] = message;
+	send(msg);
+}
+
+void lsp::handle(const json& msg)
+{
+	std::string method = msg["method"].getString();
+	const json& params = msg["params"];
+	bool request = msg.has("id");
+
+	std::string uri = params["textDocument"]["uri"].getString();
+	auto doc = docs.find(uri);
+
+	if(method == "initialize")
+	{
+		json caps;
+
+		caps["textDocumentSync"]["openClose"] = true;
+		// incremental
+		caps["textDocumentSync"]["change"] = 2;
+		caps["textDocumentSync"]["save"] = true;
+		caps["hoverProvider"] = true;
+		caps["definitionProvider"] = true;
+
+		json result;
+
+		result["capabilities"] = caps;
+		result["serverInfo"]["name"] = "sfotasm";
+		reply(msg["id"], result);
+	}
+
+	else if(method == "shutdown")
+	{
+		shutdown = true;
+		reply(msg["id"], json());
+	}
+
+	else if(method == "exit")
+	{
+		done = true;
+	}
+
+	else if(method == "textDocument/didOpen")
+	{
+		open(uri, params["textDocument"]["text"].getString());
+	}
+
+	else if(method == "textDocument/didChange" && doc != docs.end())
+	{
+		auto& changes = params["contentChanges"];
+
+		for(size_t i(0); i < changes.size(); i++)
+			change(doc->second, changes.at(i));
+
+		auto& lines = doc->second.lines;
+		std::string text = lines[0];
+
+		for(size_t i(1); i < lines.size(); i++)
+			text += "\n" + lines[i];
+
+		cache.setSource(doc->second.path, text);
+
+		// and every document that includes this one
+		for(auto& d : docs)
+		{
+			auto& files = d.second.last.files;
+
+			if(std::find(files.begin(), files.end(), doc->second.path) != files.end())
+				d.second.dirty = true;
+		}
+
+		doc->second.dirty = true;
+	}
+
+	else if(method == "textDocument/didSave")
+	{
+		// binaries and includes that aren't open may have changed on disk
+		for(auto& d : docs)
+		{
+			for(auto& f : d.second.last.files)
+				if(std::find_if(docs.begin(), docs.end(),
+					[&](const std::pair<const std::string, document>& o) { return o.second.path == f; }) == docs.end())
+					cache.forget(f);
+
+			d.second.dirty = true;
+		}
+	}
+
+	else if(method == "textDocument/didClose" && doc != docs.end())
+	{
+		json diags;
+
+		cache.forget(doc->second.path);
+
+		diags["uri"] = uri;
+		diags["diagnostics"] = json::array();
+
+		json note;
+
+		note["method"] = "textDocument/publishDiagnostics";
+		note["params"] = diags;
+		send(note);
+
+		docs.erase(doc);
+	}
+
+	else if((method == "textDocument/hover" || method == "textDocument/definition") && doc != docs.end())
+	{
+		if(doc->second.dirty)
+			analyze(uri, doc->second);
+
+		size_t line = params["position"]["line"].getNumber();
+		size_t character = params["position"]["character"].getNumber();
+
+		if(method == "textDocument/hover")
+			reply(msg["id"], hover(doc->second, line, character));
+		else
+			reply(msg["id"], definition(doc->second, line, character));
+	}
+
+	else if(request && (method == "textDocument/hover" || method == "textDocument/definition"))
+	{
+		reply(msg["id"], json());
+	}
+
+	else if(request)
+	{
+		replyError(msg["id"], -32601, "unsupported method " + method);
+	}
+}
+
+void lsp::open(std::string uri, const std::string& text)
+{
+	document& doc = docs[uri];
+	std::string path = uriToPath(uri);
+
+	// relative to the working directory like .include names, when possible
+	auto rel = std::filesystem::path(path).lexically_relative(std::filesystem::current_path());
+
+	if(!rel.empty() && rel.begin()->string() != "..")
+		path = rel.string();
+
+	doc.path = path;
+	doc.lines.clear();
+	doc.dirty = true;
+
+	std::istringstream input(text);
+
+	for(std::string line; std::getline(input, line);)
+	{
+		if(line != "" && line.back() == '\r')
+			line.pop_back();
+		doc.lines.push_back(line);
+	}
+
+	// the line after a final newline is a line for the editor as well
+	if(text == "" || text.back() == '\n')
+		doc.lines.push_back("");
+
+	cache.setSource(path, text);
+}
+
+void lsp::change(document& doc, const json& change)
+{
+	const std::string& text = change["text"].getString();
+	std::vector<std::string> added;
+
+	std::istringstream input(text);
+
+	for(std::string line; std::getline(input, line);)
+	{
+		if(line != "" && line.back() == '\r')
+			line.pop_back();
+		added.push_back(line);
+	}
+
+	if(text == "" || text.back() == '\n')
+		added.push_back("");
+
+	// no range replaces the whole document
+	if(!change.has("range"))
+	{
+		doc.lines = added;
+		return;
+	}
+
+	auto& start = change["range"]["start"];
+	auto& end = change["range"]["end"];
+
+	// a line past the last one is the end of the document
+	auto position = [&](const json& p, size_t& line, size_t& character)
+	{
+		line = p["line"].getNumber();
+		character = p["character"].getNumber();
+
+		if(line >= doc.lines.size())
+		{
+			line = doc.lines.size()-1;
+			character = doc.lines[line].length();
+		}
+
+		character = std::min(character, doc.lines[line].length());
+	};
+
+	size_t from, from_char, to, to_char;
+
+	position(start, from, from_char);
+	position(end, to, to_char);
+
+	added.front() = doc.lines[from].substr(0, from_char) + added.front();
+	added.back() += doc.lines[to].substr(to_char);
+
+	doc.lines.erase(doc.lines.begin()+from, doc.lines.begin()+to+1);
+	doc.lines.insert(doc.lines.begin()+from, added.begin(), added.end());
+}
+
+void lsp::analyze(std::string uri, document& doc)
+{
+	assemble_job job;
+
+	job.filename = doc.path;
+	job.resfilename = doc.path + ".nes";
+	job.analyze = true;
+
+	log.str("");
+
+	try
+	{
+		as.assemble(job);
+		doc.last = as.getAnalysis();
+	}
+
+	catch(const std::exception& e)
+	{
+		doc.last = analysis();
+		doc.last.failed = true;
+		doc.last.error = std::string("Internal error: ") + e.what();
+	}
+
+	doc.dirty = false;
+
+	if(!doc.last.failed)
+		doc.good = doc.last;
+
+	json diags = json::array();
+
+	if(doc.last.failed)
+	{
+		json d;
+		std::string message = doc.last.error;
+		size_t line = 0;
+
+		// errors in included files are shown on the first line
+		if(doc.last.error_file && *doc.last.error_file == doc.path && doc.last.error_line > 0)
+			line = doc.last.error_line - 1;
+		else if(doc.last.error_file)
+			message = *doc.last.error_file + ":" + std::to_string(doc.last.error_line) + ": " + message;
+
+		d["range"] = range(line, 0, line < doc.lines.size() ? doc.lines[line].length() : 0);
+		d["severity"] = 1;
+		d["source"] = "sfotasm";
+		d["message"] = message;
+		diags.push(d);
+	}
+
+	json params;
+
+	params["uri"] = uri;
+	params["diagnostics"] = diags;
+
+	json note;
+
+	note["method"] = "textDocument/publishDiagnostics";
+	note["params"] = params;
+	send(note);
+}
+
+json lsp::hover(document& doc, size_t line, size_t character)
+{
+	if(line >= doc.lines.size())
+		return json();
+
+	std::string word = wordAt(doc.lines[line], character);
+	std::string text = "";
+
+	auto symbol = doc.good.symbols.find(word);
+
+	// label.size and label.packed belong to label
+	if(symbol == doc.good.symbols.end() && word.find('.') != std::string::npos)
+		symbol = doc.good.symbols.find(word.substr(0, word.find('.')));
+
+	auto define = doc.good.defines.find(word);
+
+	if(word != "" && symbol != doc.good.symbols.end())
+		text += "`" + symbol->first + "` = $" + hexNum(symbol->second.address, 4) + "\n\n";
+
+	else if(word != "" && define != doc.good.defines.end())
+		text += "`" + define->first + "` = `" + define->second.value + "`\n\n";
+
+	auto code = doc.good.lines.find({doc.path, line+1});
+
+	if(code != doc.good.lines.end())
+		text += describeCode(code->second);
+
+	if(text == "")
+		return json();
+
+	json result;
+
+	result["contents"]["kind"] = "markdown";
+	result["contents"]["value"] = text;
+	return result;
+}
+
+json lsp::definition(document& doc, size_t line, size_t character)
+{
+	if(line >= doc.lines.size())
+		return json();
+
+	std::string word = wordAt(doc.lines[line], character);
+	std::shared_ptr<const std::string> file;
+	size_t at = 0;
+
+	auto symbol = doc.good.symbols.find(word);
+
+	if(symbol == doc.good.symbols.end() && word.find('.') != std::string::npos)
+		symbol = doc.good.symbols.find(word.substr(0, word.find('.')));
+
+	auto define = doc.good.defines.find(word);
+
+	if(word != "" && symbol != doc.good.symbols.end())
+	{
+		file = symbol->second.file;
+		at = symbol->second.line;
+	}
+
+	else if(word != "" && define != doc.good.defines.end())
+	{
+		file = define->second.file;
+		at = define->second.line;
+	}
+
+	// -D defines have no location
+	if(!file || at == 0)
+		return json();
+
+	json result;
+
+	result["uri"] = pathToUri(*file);
+	result["range"] = range(at-1, 0, 0);
+	return result;
+}
+
+std::string lsp::wordAt(const std::string& line, size_t character)
+{
+	auto part = [](char c)
+	{
+		return isalnum((unsigned char)c) || c == '_' || c == '@' || c == '.';
+	};
+
+	if(character > line.length())
+		return "";
+
+	size_t from = character;
+	size_t to = character;
+
+	while(from > 0 && part(line[from-1]))
+		from--;
+
+	while(to < line.length() && part(line[to]))
+		to++;
+
+	return line.substr(from, to - from);
+}
+
+std::string lsp::describeCode(const analysis::code& c)
+{
+	std::string text = "`$" + hexNum(c.address, 4) + "` bank " + std::to_string(c.bank) + ":";
+
+	for(size_t i(0); i+1 < c.hex.length(); i += 2)
+		text += " " + c.hex.substr(i, 2);
+
+	if(!c.instruction)
+		return text;
+
+	size_t count = 0;
+	size_t cycles = 0;
+	bool page = false;
+	bool branch = false;
+
+	for(size_t i(0); i+1 < c.hex.length(); count++)
+	{
+		auto info = codes.getOpcodeInfo(std::stoi(c.hex.substr(i, 2), 0, 16));
+
+		cycles += info.cycles;
+		page = page || info.page_cycle;
+		branch = branch || info.type == REL;
+		i += 2*std::max(info.size, 1);
+	}
+
+	text += "\n\n" + std::to_string(cycles) + " cycles";
+
+	if(count > 1)
+		text += " in " + std::to_string(count) + " instructions";
+
+	if(branch)
+		text += ", +1 when a branch is taken, +2 to another page";
+	else if(page)
+		text += ", +1 when a page is crossed";
+
+	return text;
+}
+
+std::string lsp::uriToPath(std::string uri)
+{
+	std::string path = "";
+
+	if(uri.compare(0, 7, "file://") == 0)
+		uri = uri.substr(7);
+
+	for(size_t i(0); i < uri.length(); i++)
+	{
+		if(uri[i] == '%' && i+2 < uri.length())
+		{
+			path += (char)std::stoi(uri.substr(i+1, 2), 0, 16);
+			i += 2;
+		}
+
+		else
+			path += uri[i];
+	}
+
+	return path;
+}
+
+std::string lsp::pathToUri(std::string path)
+{
+	std::string uri = "file://";
+
+	path = std::filesystem::absolute(path).lexically_normal().string();
+
+	for(unsigned char c : path)
+	{
+		if(isalnum(c) || strchr("/-_.~", c))
+			uri += c;
+		else
+			uri += "%" + hexNum(c, 2);
+	}
+
+	return uri;
+}
+
+json lsp::range(size_t line, size_t from, size_t to)
+{
+	json r;
+
+	r["start"]["line"] = line;
+	r["start"]["character"] = from;
+	r["end"]["line"] = line;
+	r["end"]["character"] = to;
+	return r;
+}
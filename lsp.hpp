@@ -0,0 +1,59 @@
+#pragma once
+
+#include "assembler.hpp"
+#include "json.hpp"
+
+// --lsp: language server on stdin/stdout. Every open document is assembled as
+// a root file from its editor buffer; the assembler keeps its parsed lines
+// between runs, so an edit only parses the lines it changed
+class lsp
+{
+public:
+	lsp();
+
+	// serves until the exit notification, returns the exit code
+	int run(std::istream& in, std::ostream& out);
+private:
+	struct document
+	{
+		std::string path;
+		std::vector<std::string> lines;
+		bool dirty = true;
+
+		// last run and the last one that got through all passes
+		analysis last;
+		analysis good;
+	};
+
+	std::istream* in;
+	std::ostream* out;
+	std::ostringstream log;
+	source_cache cache;
+	assembler as;
+	opcodes codes;
+
+	std::map<std::string, document> docs;
+	bool shutdown = false;
+	bool done = false;
+
+	bool readMessage(json& msg);
+	void send(json msg);
+	void reply(const json& id, json result);
+	void replyError(const json& id, int code, std::string message);
+
+	void handle(const json& msg);
+	void open(std::string uri, const std::string& text);
+	void change(document& doc, const json& change);
+	void analyze(std::string uri, document& doc);
+
+	json hover(document& doc, size_t line, size_t character);
+	json definition(document& doc, size_t line, size_t character);
+
+	// the symbol under the cursor
+	static std::string wordAt(const std::string& line, size_t character);
+	std::string describeCode(const analysis::code& c);
+
+	static std::string uriToPath(std::string uri);
+	static std::string pathToUri(std::string path);
+	static json range(size_t line, size_t from, size_t to);
+};
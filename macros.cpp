@@ -0,0 +1,183 @@
+#include "macros.hpp"
+
+#include <algorithm>
+#include <cctype>
+
+void macros::define(std::string name, std::vector<std::string> params, std::vector<std::string> body)
+{
+	defs[name] = {params, body};
+	cache.clear();
+}
+
+bool macros::isMacro(std::string name)
+{
+	return defs.find(name) != defs.end();
+}
+
+bool macros::repeat(const std::vector<std::string>& body, size_t count, std::string index, std::vector<std::string>& out)
+{
+	error = "";
+
+	if(count * body.size() > REPT_MAX_LINES)
+	{
+		error = "more than " + std::to_string(REPT_MAX_LINES) + " lines";
+		return false;
+	}
+
+	// the body is split once, iterations only join the parts
+	auto word = [](char c) { return std::isalnum((unsigned char)c) || c == '_' || c == '.' || c == '@'; };
+	std::vector<rept_line> lines;
+	// index names of the nested .rept blocks the line is in; their \@ and
+	// their own index are left for the nested expansion
+	std::vector<std::string> nested;
+
+	for(auto& text : body)
+	{
+		rept_line l;
+		size_t from = 0;
+
+		size_t first = text.find_first_not_of(" \t");
+		size_t last = first == std::string::npos ? first : text.find_first_of(" \t", first);
+		std::string directive = first == std::string::npos ? "" : text.substr(first, last - first);
+
+		if(directive == ".endr" && !nested.empty())
+			nested.pop_back();
+
+		bool own_unique = nested.empty();
+		bool own_index = index != "" && std::find(nested.begin(), nested.end(), index) == nested.end();
+
+		// a nested .rept gets its own index name from the line, not the number
+		size_t index_end = text.length();
+
+		if(directive == ".rept")
+		{
+			size_t comma = text.rfind(',');
+			std::string inner = "";
+
+			if(comma != std::string::npos)
+				for(char c : text.substr(comma+1))
+					if(c != ' ' && c != '\t')
+						inner += c;
+
+			if(inner == index)
+				index_end = comma;
+
+			nested.push_back(inner);
+		}
+
+		for(size_t p(0); p < text.length(); p++)
+		{
+			bool unique_mark = own_unique && text.compare(p, 2, "\\@") == 0;
+			bool index_mark = own_index && p < index_end && text.compare(p, index.length(), index) == 0 &&
+				(p == 0 || !word(text[p-1])) && (p + index.length() == text.length() || !word(text[p + index.length()]));
+
+			if(!unique_mark && !index_mark)
+				continue;
+
+			l.parts.push_back(text.substr(from, p - from));
+			l.is_index.push_back(index_mark);
+			p += (index_mark ? index.length() : 2) - 1;
+			from = p + 1;
+		}
+
+		l.parts.push_back(text.substr(from));
+		lines.push_back(l);
+	}
+
+	out.reserve(out.size() + count * body.size());
+
+	for(size_t i(0); i < count; i++)
+	{
+		std::string number = std::to_string(i);
+		std::string id = "_" + std::to_string(++unique);
+
+		for(auto& l : lines)
+		{
+			std::string text = l.parts[0];
+
+			for(size_t k(0); k < l.is_index.size(); k++)
+				text += (l.is_index[k] ? number : id) + l.parts[k+1];
+
+			out.push_back(text);
+		}
+	}
+
+	return true;
+}
+
+std::string macros::getError()
+{
+	return error;
+}
+
+bool macros::expand(std::string name, std::vector<std::string> args, std::vector<std::string>& out, size_t depth)
+{
+	error = "";
+
+	if(depth >= MACRO_MAX_DEPTH)
+	{
+		error = "more than " + std::to_string(MACRO_MAX_DEPTH) + " nested invocations in " + name;
+		return false;
+	}
+
+	macro& m = defs[name];
+
+	if(args.size() != m.params.size())
+	{
+		error = name + " takes " + std::to_string(m.params.size()) + " arguments";
+		return false;
+	}
+
+	auto key = std::make_pair(name, args);
+	auto c = cache.find(key);
+
+	if(c == cache.end())
+		c = cache.insert({key, substitute(m, args)}).first;
+
+	std::string id = "_" + std::to_string(++unique);
+
+	for(auto& l : c->second)
+	{
+		std::string text = l.text;
+
+		if(l.local)
+			for(size_t p = text.find("\\@"); p != std::string::npos; p = text.find("\\@", p))
+				text.replace(p, 2, id);
+
+		out.push_back(text);
+	}
+
+	return true;
+}
+
+std::vector<macros::macro_line> macros::substitute(macro& m, std::vector<std::string>& args)
+{
+	// longer names first so \ab is not taken for \a
+	std::vector<size_t> order;
+
+	for(size_t i(0); i < m.params.size(); i++)
+		order.push_back(i);
+
+	std::stable_sort(order.begin(), order.end(),
+		[&](size_t l, size_t r) { return m.params[l].length() > m.params[r].length(); });
+
+	std::vector<macro_line> lines;
+
+	for(auto text : m.body)
+	{
+		for(auto k : order)
+		{
+			std::string p = "\\" + m.params[k];
+
+			for(size_t pos = text.find(p); pos != std::string::npos; pos = text.find(p, pos))
+			{
+				text.replace(pos, p.length(), args[k]);
+				pos += args[k].length();
+			}
+		}
+
+		lines.push_back({text, text.find("\\@") != std::string::npos});
+	}
+
+	return lines;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+const size_t MACRO_MAX_DEPTH = 32;
+const size_t REPT_MAX_LINES = 1000000;
+
+// .macro name p1, p2 ... .endm, \p1 is replaced by the argument and \@ by a
+// suffix unique to every invocation (for local labels). .rept count, index
+// ... .endr repeats its body with index replaced by the iteration number and
+// \@ unique to every iteration
+class macros
+{
+public:
+	void define(std::string name, std::vector<std::string> params, std::vector<std::string> body);
+	bool isMacro(std::string name);
+
+	// source lines of one invocation, depth invocations deep; nested invocations
+	// are left as they are for the caller to expand after its .if lines
+	bool expand(std::string name, std::vector<std::string> args, std::vector<std::string>& out, size_t depth);
+	// body lines count times, index may be ""
+	bool repeat(const std::vector<std::string>& body, size_t count, std::string index, std::vector<std::string>& out);
+
+	std::string getError();
+private:
+	struct macro
+	{
+		std::vector<std::string> params;
+		std::vector<std::string> body;
+	};
+
+	struct macro_line
+	{
+		std::string text;
+		bool local;
+	};
+
+	// text between the places where an iteration puts its number or \@
+	struct rept_line
+	{
+		std::vector<std::string> parts;
+		// after each part but the last
+		std::vector<bool> is_index;
+	};
+
+	std::map<std::string, macro> defs;
+
+	// bodies with arguments substituted, by argument tuple
+	std::map<std::pair<std::string, std::vector<std::string>>, std::vector<macro_line>> cache;
+
+	size_t unique = 0;
+	std::string error;
+
+	std::vector<macro_line> substitute(macro& m, std::vector<std::string>& args);
+};
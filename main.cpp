@@ -1,642 +1,346 @@
-#include "preproc.hpp"
+#include "assembler.hpp"
+#include "batch.hpp"
+#include "lsp.hpp"
+#include "disasm.hpp"
 
-#include <sys/stat.h>
-#include <fstream>
-#include <sstream>
-#include <set>
-
-enum PASS_ERROR
-{
-	UNKNOWN_INSTRUCTION,
-	ILLEGAL_ADR_TYPE,
-	ORG_ADR_ERROR,
-	TOO_FAR_JMP,
-	UNKNOWN_PREPROC_INSTRUCTION,
-	ILLEGAL_OPERAND,
-	UNDEFINED_LABEL,
-	ILLEGAL_DEFINE,
-	BIN_FILE_NOT_FOUND,
-	INPUT_FILE_NOT_FOUND
-};
-
-void show(std::vector<std::string> v)
-{
-	for(auto i : v)
-		std::cout << i << std::endl;
-}
-
-std::string get_str(std::vector<std::string> op)
-{
-	std::string s = "";
-	for(auto i : op)
-		s += i;
-	return s;
-}
-
-void err_show(PASS_ERROR err, int passnum, std::string instruction)
-{
-	std::string errs;
-
-	switch(err)
-	{
-		case UNKNOWN_INSTRUCTION:
-			errs = "Unknown instruction.";
-			break;
-		case ILLEGAL_ADR_TYPE:
-			errs = "Illegal addressing type for instruction.";
-			break;
-		case ORG_ADR_ERROR:
-			errs = "Illegal address for .org command.";
-			break;
-		case TOO_FAR_JMP:
-			errs = "Too far jump.";
-			break;
-		case UNKNOWN_PREPROC_INSTRUCTION:
-			errs = "Unknown preprocessing instruction.";
-			break;
-		case ILLEGAL_OPERAND:
-			errs = "Illegal operand.";
-			break;
-		case UNDEFINED_LABEL:
-			errs = "Undefined label.";
-			break;
-		case ILLEGAL_DEFINE:
-			errs = "Defined names must start with @";
-			break;
-		case BIN_FILE_NOT_FOUND:
-			errs = "Binary file not found.";
-			break;
-	}
-
-	std::cout << "sfotasm: error on PASS " << std::to_string(passnum) << ": " << errs << std::endl;
-	std::cout << "sfotasm: instruction: " << instruction << std::endl;
-	exit(0);
-}
-
-std::vector<std::string> makeVectorFromFile(std::string filename)
-{
-	std::ifstream input(filename);
-	std::vector<std::string> strs;
-	std::string tmp_line;
-
-	if(!input.good())
-	{
-		std::cout << "sfotasm: file not found." << std::endl;
-		exit(0);
-	}
-
-	for(std::string line; std::getline(input, line);)
-	{
-		if(line == "" || line[0] == ';')
-			continue;
-
-		int i = 0;
-		while(line[i] == ' ')
-			i++;
-
-		for(; i < line.size(); i++)
-		{
-			if(line[i] == ';')
-				break;
-			if(line[i] == '\t' || line[i] == '\n')
-				continue;
-			tmp_line += line[i];
-		}
-
-		if(tmp_line != "")
-			strs.push_back(tmp_line);
-		tmp_line = "";
-	}
-
-	return strs;
-}
-
-void writeBinary(std::string code, std::string filename)
-{
-	std::ofstream output(filename, std::ios::binary);
-	unsigned char b;
-
-	for(int i = 0; i < code.length()-1; i += 2)
-	{
-		std::string byte = std::string(1, code[i]) + std::string(1, code[i+1]);
-		b = std::stoi(byte, 0, 16);
-
-		output << b;
-	}
-}
-
-void writeListring(std::string listing, std::string filename)
-{
-	std::ofstream output(filename);	
-
-	output << listing;
-}
-
-std::map<std::string, std::string> def_addrs;
-std::vector<std::string> def_names;
-
-void initDefs()
-{
-	def_addrs["@START"] = "$C000";
-	def_addrs["@INTS"] = "$FFFA";
-	def_addrs["@JOY1"] = "$4016";
-	def_addrs["@JOY2"] = "$4017";
-	def_addrs["@APU_PULSE1_CTRL"] = "$4000";
-	def_addrs["@APU_PULSE1_RCTRL"] = "$4001";
-	def_addrs["@APU_PULSE1_FT"] = "$4002";
-	def_addrs["@APU_PULSE1_CT"] = "$4003";
-
-	def_names = {"@START", "@INTS", "@JOY1", "@JOY2", "@APU_PULSE1_CTRL",
-				 "@APU_PULSE1_RCTRL", "@APU_PULSE1_FT", "@APU_PULSE1_CT"};
-}
+#include <thread>
+#include <cctype>
 
 void show_help()
 {
 	std::cout << "sfotasm\n";
 	std::cout << "6502 NES assembler\n\nUsage:\n";
-	std::cout << "\tsfotasm inputfile.asm [outputfile.nes]";
+	std::cout << "\tsfotasm inputfile.asm [outputfile.nes] [options]\n";
+	std::cout << "\tsfotasm --batch manifest [options]\n\nOptions:\n";
+	std::cout << "\t-DNAME[=VALUE]\t\tdefine @NAME as VALUE (default 1)\n";
+	std::cout << "\t--batch manifest\tassemble every 'input output [-DNAME=VALUE...]' line of manifest\n";
+	std::cout << "\t--variant name:-DA,-DB=1\twrite outputfile.name.nes with these defines too (repeatable)\n";
+	std::cout << "\t--var-profile file.prof\tweight .var references by the instruction counts of a profile\n";
+	std::cout << "\t--dce\t\t\tleave out unreferenced label blocks, listed in outputfile.nes.dce\n";
+	std::cout << "\t--patch-against old.nes\twrite an outputfile.nes.ips patch from old.nes, the ROM only if it changed\n";
+	std::cout << "\t--patch-format bps\twrite outputfile.nes.bps instead\n";
+	std::cout << "\t--patch-only\t\twrite the patch without the ROM\n";
+	std::cout << "\t--single-pass\t\temit bytes in the first pass, patching forward references\n";
+	std::cout << "\t--prefetch N\t\tread included files ahead on N threads (default 4, 0 is off)\n";
+	std::cout << "\t--sym\t\t\twrite outputfile.nes.sym with banks and labels\n";
+	std::cout << "\t--disasm rom.nes [sym]\tdisassemble the PRG, with rom.nes.sym labels if present\n";
+	std::cout << "\t--diff a.nes b.nes\tcompare the PRG of two ROMs instruction by instruction\n";
+	std::cout << "\t--lsp\t\t\trun as a language server on stdin/stdout\n";
+	std::cout << "\t-j N\t\t\tuse N threads for --batch (default: all cores)\n";
+	std::cout << "\t-MD\t\t\twrite a make dependency file (output with .d extension)\n";
+	std::cout << "\t-MF file\t\twrite the dependency file to file\n";
+	std::cout << "\t-MP\t\t\tadd an empty target for every dependency\n";
+	std::cout << "\t--profile-frames N\trun the result for N frames and write a profile\n";
+	std::cout << "\t--profile-cycles N\trun the result for N cycles and write a profile\n";
+	std::cout << "\t--profile-entry label\tstart the profiler run from label instead of reset";
 	std::cout << std::endl;
 }
 
-int main(int argc, char** argv)
+// the number after option, exits with the help when it isn't one
+size_t parse_count(std::string option, std::string value)
 {
-	std::string filename = "asm.asm";
-	std::string resfilename = "result.nes";
+	size_t pos = 0;
+	size_t n = 0;
 
-	if(argc > 1)
+	try
 	{
-		filename = std::string(argv[1]);
+		n = std::stoul(value, &pos);
+	}
 
-		if(argc > 2)
-			resfilename = std::string(argv[2]);
+	catch(std::exception&)
+	{
+		pos = 0;
 	}
 
-	else
+	if(value == "" || !std::isdigit((unsigned char)value[0]) || pos != value.length())
 	{
+		std::cout << "sfotasm: " << option << " takes a number, not " << value << "\n";
 		show_help();
-		exit(0);
+		exit(1);
 	}
 
-	auto insts = makeVectorFromFile(filename);
-
-	const int START_ADR = 0xC000;
-
-	size_t bank = 0;
-	size_t real_adr = START_ADR;
-	size_t rsset = 0;
-	size_t instr_num = 0;
-
-	std::map<std::string, size_t> label_adrs;
-	std::map<size_t, size_t> rel_adrs;
-	std::vector<std::string> label_names;
-	std::vector<std::string> rs_names;
-	std::set<size_t> used_banks;
+	return n;
+}
 
-	instructions inst;
-	preproc pr;
+int main(int argc, char** argv)
+{
+	assemble_job job;
 
-	// PASS 0: add includes
+	std::string manifest = "";
+	size_t threads = std::thread::hardware_concurrency();
 
-	size_t len = insts.size();
+	std::vector<std::string> files;
+	std::vector<std::string> variants;
+	bool lsp_mode = false;
+	bool disasm_mode = false;
+	bool diff_mode = false;
 
-	for(size_t i(0); i < len; i++)
+	for(int i(1); i < argc; i++)
 	{
-		auto res = inst.parseInstruction(insts[i]);
+		std::string arg = argv[i];
 
-		if(res[0] == PREPROC_SIGN)
+		if(arg == "--profile-frames" && i+1 < argc)
 		{
-			auto prres = pr.parsePreprocInstruction(insts[i]);
-
-			if(prres[0] == PREPROC_INCLUDE_SIGN)
-			{
-				auto f = makeVectorFromFile(prres[1]);
-				std::reverse(std::begin(f), std::end(f));
-
-				insts.erase(insts.begin()+i);
-
-				for(auto j : f)
-					insts.insert(insts.begin()+i, j);
-
-				len += f.size()-1;
-			}
+			job.profiling = true;
+			job.profile_frames = parse_count(arg, argv[++i]);
 		}
 
-	}
-
-	// PASS 1: some preprocessing, label setting, syntax checking
-
-	bool defaddrs = false;
-	initDefs();
-
-	std::map<std::string, std::string> user_def_addrs;
-	std::vector<std::string> user_def_names;
-
-	for(auto& i : insts)
-	{
-		if(defaddrs)
+		else if(arg == "--profile-cycles" && i+1 < argc)
 		{
-			for(auto j : def_names)
-			{
-					if(i.find(j) != -1)
-					{
-						i.replace(i.find(j), i.length(), def_addrs[j]);
-					}
-			}
+			job.profiling = true;
+			job.profile_cycles = parse_count(arg, argv[++i]);
 		}
 
-		for(auto j : user_def_names)
+		else if(arg == "--profile-entry" && i+1 < argc)
 		{
-			if(i.find(j) != -1)
-			{
-				i.replace(i.find(j), i.length(), user_def_addrs[j]);
-			}
+			job.profiling = true;
+			job.entry_label = argv[++i];
 		}
 
-		auto res = inst.parseInstruction(i);
-
-		if(res[0] == COMMENT_SIGN)
-			continue;
-		else if(res[0] == ERROR_ILLEGAL_INSTRUCTION_SIGN)
-			err_show(UNKNOWN_INSTRUCTION, 1, i);
-		else if(res[0] == ERROR_ILLEGAL_OPERAND_SIGN)
-			err_show(ILLEGAL_OPERAND, 1, i);
-
-		if(res[0] == PREPROC_SIGN)
+		else if(arg == "--batch" && i+1 < argc)
 		{
-			auto prres = pr.parsePreprocInstruction(i);
+			manifest = argv[++i];
+		}
 
-			if(prres[0] == PREPROC_ERROR)
-				err_show(UNKNOWN_PREPROC_INSTRUCTION, 1, i);
+		else if(arg == "--variant" && i+1 < argc)
+		{
+			variants.push_back(argv[++i]);
+		}
 
-			else if(prres[0] == PREPROC_USE_ILLOPCODES_SIGN)
-			{
-				inst.addIllegalOpcodes();
-			}
+		else if(arg == "--var-profile" && i+1 < argc)
+		{
+			job.var_profile = argv[++i];
+		}
 
-			else if(prres[0] == PREPROC_USE_DEFS_SIGN)
-			{
-				defaddrs = true;
-			}
+		else if(arg == "--dce")
+		{
+			job.dce = true;
+		}
 
-			else if(prres[0] == PREPROC_DEFINE_SIGN)
-			{
-				if(prres[1][0] != '@')
-					err_show(ILLEGAL_DEFINE, 1, i);
+		else if(arg == "--patch-against" && i+1 < argc)
+		{
+			job.patch_against = argv[++i];
+		}
 
-				user_def_names.push_back(prres[1]);
-				user_def_addrs[prres[1]] = prres[2];
-			}
+		else if(arg == "--patch-format" && i+1 < argc)
+		{
+			job.patch_format = argv[++i];
 
-			else if(prres[0] == PREPROC_OFFSET_SIGN)
+			if(!patch::isFormat(job.patch_format))
 			{
-				int adr = std::stoi(prres[1]);
-
-				if(adr >= (bank+1)*0x2000 + 0xC000)
-					err_show(ORG_ADR_ERROR, 1, i);
-
-				if(adr >= bank*0x2000 + 0xC000)
-					real_adr = adr;
-				else
-					real_adr = adr + (bank*0x2000 + 0xC000);
+				std::cout << "sfotasm: unknown patch format " << job.patch_format << ", use ips or bps" << std::endl;
+				exit(1);
 			}
+		}
 
-			else if(prres[0] == PREPROC_BANK_SIGN)
-			{
-				bank = std::stoi(prres[1]);
-				used_banks.insert(bank);
-				real_adr = bank*0x2000 + 0xC000;
-			}
+		else if(arg == "--patch-only")
+		{
+			job.patch_only = true;
+		}
 
-			else if(prres[0] == PREPROC_RSSET_SIGN)
-			{
-				rsset = std::stoi(prres[1]);
-			}
+		else if(arg == "--single-pass")
+		{
+			job.single_pass = true;
+		}
 
-			else if(prres[0] == PREPROC_RS_SIGN)
-			{
-				std::string rs_name = prres[1];
-				size_t bytes = std::stoi(prres[2]);
+		else if(arg == "--prefetch" && i+1 < argc)
+		{
+			job.prefetch_threads = parse_count(arg, argv[++i]);
+		}
 
-				label_names.push_back(rs_name);
-				label_adrs[rs_name] = rsset;
-				rsset += bytes;
-			}
+		else if(arg == "--sym")
+		{
+			job.symbols = true;
+		}
 
-			else if(prres[0] == PREPROC_DB_SIGN)
-			{
-				real_adr += prres.size()-1;
-			}
+		else if(arg == "--disasm")
+		{
+			disasm_mode = true;
+		}
 
-			else if(prres[0] == PREPROC_DW_SIGN)
-			{
-				real_adr += 2*(prres.size()-1);
-			}
+		else if(arg == "--diff")
+		{
+			diff_mode = true;
+		}
 
-			else if(prres[0] == PREPROC_DW_LABEL_SIGN)
-			{
-				real_adr += 2;
-			}
+		else if(arg == "--lsp")
+		{
+			lsp_mode = true;
 		}
 
-		else if(res[0] == LABEL_SIGN)
+		else if(arg == "-j" && i+1 < argc)
 		{
-			label_names.push_back(res[1]);
-			label_adrs[res[1]] = real_adr;
+			threads = parse_count(arg, argv[++i]);
 		}
 
-		else if(res[0] == RELATIVE_SIGN)
+		else if(arg == "-MD")
 		{
-			real_adr += 2;
-			rel_adrs[instr_num] = real_adr;
+			job.depfile = true;
 		}
 
-		else if(res[0] == RELATIVE_ADDR_SIGN)
+		else if(arg == "-MF" && i+1 < argc)
 		{
-			real_adr += 2;
-			rel_adrs[instr_num] = real_adr;
+			job.depfile = true;
+			job.depfilename = argv[++i];
 		}
 
+		else if(arg == "-MP")
+		{
+			job.phony_deps = true;
+		}
 
-		else
+		else if(arg.compare(0, 2, "-D") == 0 && arg.length() > 2)
 		{
-			real_adr += res.size();
+			job.defines.push_back(arg.substr(2));
 		}
 
-		instr_num++;
+		else
+			files.push_back(arg);
 	}
 
+	if(lsp_mode)
+	{
+		// in_avail() only sees buffered input without stdio sync
+		std::ios::sync_with_stdio(false);
 
-	// PASS 2: syntax checking, prog making
-
-	std::string prog[127];
-	bank = 0;
-	size_t position = 0;
-	size_t chr_size = 0;
-	std::map<size_t, size_t> positions;
-
-	bool listed = false;
-	bool nowlisting = false;
-	std::string listing = "";
-
-	instr_num = 0;
-
-	for(auto i : insts)
-	{	
-		auto res = inst.parseInstruction(i);
+		lsp server;
+		exit(server.run(std::cin, std::cout));
+	}
 
-		if(res[0] == PREPROC_SIGN)
+	if(disasm_mode || diff_mode)
+	{
+		if(files.size() < (diff_mode ? 2 : 1))
 		{
-			auto prres = pr.parsePreprocInstruction(i);
-
-			if(prres[0] == PREPROC_BANK_SIGN)
-			{
-				positions[bank] = position;
-				bank = std::stoi(prres[1]);
-				position = positions[bank];
-			}
-
-			else if(prres[0] == PREPROC_OFFSET_SIGN)
-			{
-				int adr = std::stoi(prres[1]);
-
-				if(adr >= bank*0x2000 + 0xC000)
-					position = (adr - (0xC000 + bank*0x2000))*2;
-				else
-					position = adr*2;	
-
-				while(position > prog[bank].size())
-					prog[bank] += "FF";		
-			}
-
-			else if(prres[0] == PREPROC_DB_SIGN)
-			{
-				for(size_t i(1); i < prres.size(); i++)
-				{
-					prog[bank] += prres[i];
-					position += 2;
-				}
-			}
-
-			else if(prres[0] == PREPROC_DW_SIGN)
-			{
-				for(size_t i(1); i < prres.size(); i++)
-				{
-					prog[bank] += prres[i];
-					position += 4;
-				}
-			}
-
-			else if(prres[0] == PREPROC_LIST_SIGN)
-			{
-				listed = true;
-				nowlisting = true;
-			}
-
-			else if(prres[0] == PREPROC_NOLIST_SIGN)
-			{
-				nowlisting = false;
-			}				
+			show_help();
+			exit(1);
+		}
 
-			else if(prres[0] == PREPROC_DW_LABEL_SIGN)
+		// rom.nes.sym next to the ROM when there is one
+		auto load = [&](disassembler& d, std::string rom, std::string sym)
+		{
+			if(!d.load(rom) || (sym != "" && !d.loadSymbols(sym)))
 			{
-				if(std::find(label_names.begin(), label_names.end(), prres[1]) == label_names.end())
-					err_show(UNDEFINED_LABEL, 2, i);
-
-				size_t addr = label_adrs[prres[1]];
-				std::stringstream s;
-				std::string num;
-				s << std::hex << std::uppercase << addr;
-				num = s.str();
-
-				while(num.length() < 4)
-					num = "0" + num;
-
-				prog[bank] += std::string(1,num[2]) + std::string(1,num[3]);
-				prog[bank] += std::string(1,num[0]) + std::string(1,num[1]);
-				position += 2 * 2;
+				std::cout << "sfotasm: " << d.getError() << std::endl;
+				exit(1);
 			}
 
-			else if(prres[0] == PREPROC_INCBIN_SIGN)
-			{
-				std::string hex;
-				unsigned char* buffer;
-
-				struct stat bf;
-
-				if(stat(prres[1].c_str(), &bf) != 0)
-					err_show(BIN_FILE_NOT_FOUND, 2, i);
-
-				FILE* fptr = fopen(prres[1].c_str(), "rb");
-
-				fseek(fptr, 0, SEEK_END);
-				unsigned long fileLen = ftell(fptr);
-				fseek(fptr, 0, SEEK_SET);
+			if(sym == "" && std::ifstream(rom+".sym").good())
+				d.loadSymbols(rom+".sym");
+		};
 
-				buffer = (unsigned char*)malloc(fileLen+1);
+		disassembler a;
 
-				fread(buffer, fileLen, 1, fptr);
-				fclose(fptr);
-
-				for(size_t i(0); i < fileLen+1; i++)
-				{
-					std::stringstream ss;
-					ss << std::hex << std::uppercase << (unsigned int)buffer[i];
-					hex = ss.str();
-
-					while(hex.length() < 2)
-						hex = "0" + hex;
-
-					prog[bank] += hex;
-
-					chr_size++;
-
-					position += 2;
-					real_adr++;
-
-					if(chr_size >= pr.getChrSizeKb()*1024)
-						break;					
-				}
-
-				free(buffer);
-			}
-		}
-
-		else if(res[0] == LABEL_CALL_SIGN)
+		if(disasm_mode)
 		{
-			if(std::find(label_names.begin(), label_names.end(), res[1]) == label_names.end())
-				err_show(UNDEFINED_LABEL, 2, i);
-
-			size_t addr = label_adrs[res[1]];
-			std::stringstream s;
-			std::string num;
-			s << std::hex << std::uppercase << addr;
-			num = s.str();
-
-			while(num.length() < 4)
-				num = "0" + num;
-
-			prog[bank] += res[2];
-			prog[bank] += std::string(1,num[2]) + std::string(1,num[3]);
-			prog[bank] += std::string(1,num[0]) + std::string(1,num[1]);
-			position += 3*2;
-
-			if(nowlisting)
-			{
-				listing += res[2];
-				listing += std::string(1,num[2]) + std::string(1,num[3]);
-				listing += std::string(1,num[0]) + std::string(1,num[1]);				
-				listing += "\t" + i + "\n";			
-			}
+			load(a, files[0], files.size() > 1 ? files[1] : "");
+			std::cout << a.listing();
+			exit(0);
 		}
 
-		else if(res[0] == RELATIVE_SIGN)
-		{
-			prog[bank] += res[2];
-
-			int adr = label_adrs[res[1]] - rel_adrs[instr_num];
-			if(adr < 0)
-			{
-				if(adr < -0xFF)
-					err_show(TOO_FAR_JMP, 2, i);
-				adr = 0xFF - (rel_adrs[instr_num] - label_adrs[res[1]] - 1);
-			}
+		disassembler b;
 
-			if(adr > 0xFF)
-				err_show(TOO_FAR_JMP, 2, i);
+		load(a, files[0], "");
+		load(b, files[1], "");
 
-			std::stringstream s;
-			std::string hx;
-			s << std::hex << std::uppercase << adr;
-			hx = s.str();
+		std::string d = a.diff(b);
 
-			if(hx.length() < 2)
-				hx = "0" + hx;
+		std::cout << d;
+		exit(d == "" ? 0 : 1);
+	}
 
-			if(nowlisting)
-				listing += "00"+res[2]+hx + "\t" + i + "\n";
+	if(manifest != "")
+	{
+		batch b;
 
-			prog[bank] += hx;
-			position += 2*2;
+		if(job.depfilename != "")
+		{
+			std::cout << "sfotasm: -MF can't be used with --batch, -MD writes one file per job" << std::endl;
+			exit(1);
 		}
 
-		else if(res[0] == RELATIVE_ADDR_SIGN)
+		if(!b.readManifest(manifest, job))
 		{
-			prog[bank] += res[2];
+			std::cout << "sfotasm: " << b.getError() << std::endl;
+			exit(1);
+		}
 
-			int adr = std::stoi(res[1], 0, 16) - rel_adrs[instr_num];			
+		size_t failed = b.run(threads);
 
-			if(adr < 0)
-			{
-				if(adr < -0xFF)
-					err_show(TOO_FAR_JMP, 2, i);
-				adr = 0xFF - (rel_adrs[instr_num] - std::stoi(res[1], 0, 16) - 1);
-			}
+		if(failed)
+		{
+			std::cout << "sfotasm: " << failed << " of " << b.getJobCount() << " jobs failed" << std::endl;
+			exit(1);
+		}
 
-			if(adr > 0xFF)
-				err_show(TOO_FAR_JMP, 2, i);
+		exit(0);
+	}
 
-			std::stringstream s;
-			std::string hx;
-			s << std::hex << std::uppercase << adr;
-			hx = s.str();
+	if(files.size() > 0)
+	{
+		job.filename = files[0];
 
-			if(hx.length() < 2)
-				hx = "0" + hx;
+		if(files.size() > 1)
+			job.resfilename = files[1];
+	}
 
-			if(nowlisting)
-				listing += "00"+res[2]+hx + "\t" + i + "\n";
+	else
+	{
+		show_help();
+		exit(0);
+	}
 
-			prog[bank] += hx;
-			position += 2*2;
-		}
+	if(!variants.empty())
+	{
+		// one process for all variants: the sources are read and parsed once
+		batch b;
 
-		else if(res[0] == LABEL_SIGN)
+		if(job.depfilename != "")
 		{
-			instr_num++;
-			continue;
+			std::cout << "sfotasm: -MF can't be used with --variant, -MD writes one file per variant" << std::endl;
+			exit(1);
 		}
 
-		else
+		size_t dot = job.resfilename.rfind('.');
+
+		if(dot == std::string::npos || job.resfilename.find_first_of("/\\", dot) != std::string::npos)
+			dot = job.resfilename.length();
+
+		for(auto& v : variants)
 		{
-			std::string opc = get_str(res);
+			size_t colon = v.find(':');
+			assemble_job variant = job;
 
-			if(nowlisting)
+			if(colon == 0 || v.substr(0, colon).find_first_of("/\\") != std::string::npos)
 			{
-				std::string zopc = opc;
-				while(zopc.size() < 6)
-					zopc = "0" + zopc;
-				listing += zopc + "\t" + i + "\n";
+				std::cout << "sfotasm: bad variant name in " << v << std::endl;
+				exit(1);
 			}
 
-			prog[bank] += opc;
-			position += res.size()*2;
-		}
+			variant.resfilename = job.resfilename.substr(0, dot) + "." + v.substr(0, colon) + job.resfilename.substr(dot);
 
-		instr_num++;
-	}
+			if(colon != std::string::npos)
+				for(auto& d : preproc::splitArgs(" " + v.substr(colon+1)))
+					if(d != "")
+						variant.defines.push_back(d.compare(0, 2, "-D") == 0 ? d.substr(2) : d);
 
-	std::string prog_res;
+			b.addJob(variant);
+		}
 
-	for(size_t i(0); i <= *used_banks.rbegin(); i++)
-	{
-		if(used_banks.find(i) != used_banks.end())
-		{
-			std::string tmp = prog[i];
+		size_t failed = b.run(threads);
 
-			while(tmp.length() < 8*1024*2)
-				tmp += "F";
-			prog_res += tmp;
+		if(failed)
+		{
+			std::cout << "sfotasm: " << failed << " of " << b.getJobCount() << " variants failed" << std::endl;
+			exit(1);
 		}
 
-		else
-			for(int i = 0; i != 8*1024*2; i++)
-				prog_res += "F";
+		exit(0);
 	}
 
-	prog_res = pr.makeHeader() + prog_res;
-
-	writeBinary(prog_res, resfilename);
+	// the cache holds what the prefetch threads read
+	source_cache cache;
+	assembler as(std::cout, &cache);
 
-	if(listed)
-		writeListring(listing, resfilename+".lst");
-}
\ No newline at end of file
+	if(!as.assemble(job))
+		exit(1);
+}
@@ -1,29 +1,50 @@
 #include "opcodes.hpp"
 
-opcodes::opcodes()
+std::string hexNum(size_t v, size_t width)
 {
-	initOpcodes();
+	std::stringstream s;
+	s << std::hex << std::uppercase << v;
+
+	std::string hx = s.str();
+
+	while(hx.length() < width)
+		hx = "0" + hx;
+
+	return hx;
 }
 
-void opcodes::initOpcodes()
+opcodes::opcodes() : table(sharedTable())
 {
-	std::stringstream f(getOpcodesList());
+}
+
+const opcode_table& opcodes::sharedTable()
+{
+	static const opcode_table t = []
+	{
+		opcode_table t;
 
-	std::string opname;
-	std::string curtype;
+		readList(LEGAL_OPCODES, sizeof(LEGAL_OPCODES)/sizeof(opcode_row), t.legal, t.legal_names);
+		readList(ILLEGAL_OPCODES, sizeof(ILLEGAL_OPCODES)/sizeof(opcode_row), t.illegal, t.illegal_names);
+		initDecodeTable(t);
 
-	for(int i(0); i < 57; i++)
+		return t;
+	}();
+
+	return t;
+}
+
+void opcodes::readList(const opcode_row* rows, size_t count, std::map<const std::pair<std::string, OPCODE_TYPE>, std::string>& codes,
+	std::vector<std::string>& names)
+{
+	for(size_t i(0); i < count; i++)
 	{
-		f >> opname;
-		opcode_names.push_back(opname);
+		names.push_back(rows[i].name);
 
-		for(int j(0); j < 9; j++)
+		for(int j(0); j < OPCODE_COLUMNS; j++)
 		{
-			f >> curtype;
-
-			if(curtype != "ne")
+			if(rows[i].codes[j] >= 0)
 			{
-				opcode[{opname, (OPCODE_TYPE)j}] = curtype;
+				codes[{rows[i].name, (OPCODE_TYPE)j}] = hexNum(rows[i].codes[j], 2);
 			}
 		}
 	}
@@ -31,133 +52,156 @@ void opcodes::initOpcodes()
 
 void opcodes::initIllegalOpcodes()
 {
-	std::stringstream f(getIllegalOpcodesList());
+	use_illegal = true;
+}
+
+std::string opcodes::getOpcode(std::string name, OPCODE_TYPE addr_type)
+{
+	// illegal opcodes take precedence once enabled (SBC #imm becomes EB)
+	if(use_illegal)
+	{
+		auto il = table.illegal.find({name, addr_type});
+
+		if(il != table.illegal.end())
+			return il->second;
+	}
+
+	auto opc = table.legal.find({name, addr_type});
+
+	if(opc == table.legal.end())
+		return ERROR_ILLEGAL_OPERAND_SIGN_OP;
+	else
+		return opc->second;
+} 
+
+opcode_info opcodes::getOpcodeInfo(unsigned char code)
+{
+	return table.decode[code];
+}
 
-	std::string opname;
-	std::string curtype;
+std::string opcodes::getZeroPageOpcode(std::string abs)
+{
+	auto info = getOpcodeInfo(std::stoi(abs, 0, 16));
+	OPCODE_TYPE tp;
+
+	if(info.type == ABS)
+		tp = ZP;
+	else if(info.type == ABSX)
+		tp = ZPX;
+	// zp,Y of LDX sits in the zp,X column
+	else if(info.type == ABSY && info.name == "LDX")
+		tp = ZPX;
+	else
+		return "";
+
+	std::string opc = getOpcode(info.name, tp);
+
+	return opc == ERROR_ILLEGAL_OPERAND_SIGN_OP ? "" : opc;
+}
 
-	for(int i(0); i < 57; i++)
+void opcodes::initDecodeTable(opcode_table& t)
+{
+	std::stringstream cycles(getCyclesList());
+	std::string cyc;
+
+	for(int i(0); i < 256; i++)
 	{
-		f >> opname;
-		opcode_names.push_back(opname);
+		cycles >> cyc;
+
+		t.decode[i].name = "";
+		t.decode[i].type = IMPLIED;
+		t.decode[i].size = 1;
+		t.decode[i].cycles = std::stoi(cyc);
+		t.decode[i].page_cycle = cyc.back() == '+';
+		t.decode[i].illegal = false;
+	}
 
-		for(int j(0); j < 9; j++)
+	const opcode_row* lists[2] = {LEGAL_OPCODES, ILLEGAL_OPCODES};
+	size_t counts[2] = {sizeof(LEGAL_OPCODES)/sizeof(opcode_row), sizeof(ILLEGAL_OPCODES)/sizeof(opcode_row)};
+
+	for(int l(0); l < 2; l++)
+	{
+		for(size_t r(0); r < counts[l]; r++)
 		{
-			f >> curtype;
+			std::string opname = lists[l][r].name;
 
-			if(curtype != "ne")
+			for(int j(0); j < OPCODE_COLUMNS; j++)
 			{
-				opcode[{opname, (OPCODE_TYPE)j}] = curtype;
+				int code = lists[l][r].codes[j];
+
+				if(code < 0)
+					continue;
+
+				if(t.decode[code].name != "")
+					continue;
+
+				OPCODE_TYPE tp = (OPCODE_TYPE)j;
+
+				// the assembler table keeps these modes in neighbouring columns
+				if(tp == IMPLIED && isRelativeKeyword(opname))
+					tp = REL;
+				else if(tp == IMPLIED && opname == "JMP")
+					tp = IND;
+				else if(tp == ZPX && (opname == "LDX" || opname == "STX"))
+					tp = ZPY;
+
+				t.decode[code].name = opname;
+				t.decode[code].type = tp;
+				t.decode[code].illegal = l == 1;
+
+				switch(tp)
+				{
+					case IMPLIED:
+						t.decode[code].size = 1;
+						break;
+					case ABS:
+					case ABSX:
+					case ABSY:
+					case IND:
+						t.decode[code].size = 3;
+						break;
+					default:
+						t.decode[code].size = 2;
+				}
 			}
 		}
 	}
 }
 
-std::string opcodes::getOpcode(std::string name, OPCODE_TYPE addr_type)
-{
-	std::string opc = opcode[{name, addr_type}];
-
-	if(opc == "")
-		return ERROR_ILLEGAL_OPERAND_SIGN_OP;
-	else
-		return opc;
-} 
-
 bool opcodes::isKeyword(std::string name)
 {
-	return std::find(opcode_names.begin(), opcode_names.end(), name) != opcode_names.end();
+	if(std::find(table.legal_names.begin(), table.legal_names.end(), name) != table.legal_names.end())
+		return true;
+
+	return use_illegal && std::find(table.illegal_names.begin(), table.illegal_names.end(), name) != table.illegal_names.end();
 }
 
 bool opcodes::isRelativeKeyword(std::string name)
 {
-	return std::find(rel_opcodes.begin(), rel_opcodes.end(), name) != rel_opcodes.end();	
-}
+	static const std::vector<std::string> rel_opcodes = {"BCC", "BCS", "BEQ", "BMI", "BNE", "BPL", "BVC", "BVS"};
 
-std::string opcodes::getOpcodesList()
-{
-	return"\
-ADC 	ne	61 	71 	6D 	7D 	69 	79 	65 	75 \
-AND		ne	21 	31 	2D 	3D 	29 	39 	25 	35 \
-ASL  	0A 	ne	ne	ne	ne	ne	ne	06 	16 \
-BCC 	90 	ne	ne	ne	ne	ne	ne	ne	ne \
-BCS  	B0 	ne	ne	ne	ne	ne	ne	ne	ne \
-BEQ  	F0 	ne	ne	ne	ne	ne	ne	ne	ne \
-BIT 	ne	ne	ne	2C 	ne	ne	ne	24 	ne \
-BMI 	30 	ne	ne	ne	ne	ne	ne	ne	ne \
-BNE  	D0 	ne	ne	ne	ne	ne	ne	ne	ne \
-BPL 	10 	ne	ne	ne	ne	ne	ne	ne	ne \
-BVC 	50 	ne	ne	ne	ne	ne	ne	ne	ne \
-BVS 	70 	ne	ne	ne	ne	ne	ne	ne	ne \
-CLC 	18 	ne	ne	ne	ne	ne	ne	ne	ne \
-CLD 	D8 	ne	ne	ne	ne	ne	ne	ne	ne \
-CLI 	58 	ne	ne	ne	ne	ne	ne	ne	ne \
-CLV 	B8 	ne	ne	ne	ne	ne	ne	ne	ne \
-CMP 	ne	C1 	D1 	CD 	DD 	C9 	D9 	C5 	D5 \
-CPX 	ne	ne	ne	EC 	ne	E0 	ne	E4 	ne \
-CPY 	ne	ne	ne	CC 	ne	C0 	ne	C4 	ne \
-\
-DEC 	ne	ne	ne	CE 	DE 	ne	ne	C6 	D6 \
-DEX 	CA 	ne	ne	ne	ne	ne	ne	ne	ne \
-DEY 	88 	ne	ne	ne	ne	ne	ne	ne	ne \
-EOR 	ne	41 	51 	4D 	5D 	49 	59 	45 	55 \
-INC 	ne	ne	ne	EE 	FE 	ne	ne	E6 	F6 \
-INX 	E8 	ne	ne	ne	ne	ne	ne	ne	ne \
-INY 	C8 	ne	ne	ne	ne	ne	ne	ne	ne \
-JMP 	6C 	ne	ne	4C 	ne	ne	ne	ne	ne \
-JSR 	ne 	ne	ne	20	ne	ne	ne	ne	ne \
-LDA 	ne	A1 	B1 	AD 	BD 	A9 	B9 	A5 	B5 \
-LDX 	ne	ne	ne	AE 	ne	A2 	BE 	A6 	B6 \
-LDY 	ne	ne	ne	AC 	BC 	A0 	ne	A4 	B4 \
-LSR 	4A 	ne	ne	4E 	5E 	ne	ne	46 	ne \
-NOP 	EA 	ne	ne	ne	ne	ne	ne	ne	ne \
-ORA 	ne	01 	11 	0D 	1D 	09 	19 	05 	15 \
-PHA 	48 	ne	ne	ne	ne	ne	ne	ne	ne \
-PHP 	08 	ne	ne	ne	ne	ne	ne	ne	ne \
-PLA 	68 	ne	ne	ne	ne	ne	ne	ne	ne \
-PLP 	28 	ne	ne	ne	ne	ne	ne	ne	ne \
-\
-ROL 	2A 	ne	ne	2E 	ne	ne	ne	26 	36 \
-ROR 	6A 	ne	ne	6E 	7E 	ne	ne	66 	76 \
-RTI 	40 	ne	ne	ne	ne	ne	ne	ne	ne \
-RTS 	60 	ne	ne	ne	ne	ne	ne	ne	ne \
-SBC 	ne	E1 	F1 	ED 	FD 	E9 	F9 	E5 	F5 \
-SEC 	38 	ne	ne	ne	ne	ne	ne	ne	ne \
-SED 	F8 	ne	ne	ne	ne	ne	ne	ne	ne \
-SEI 	78 	ne	ne	ne	ne	ne	ne	ne	ne \
-STA 	ne	81 	91 	8D 	9D 	ne	99 	85 	95 \
-STX 	ne	ne	ne	8E 	ne	ne	ne	86 	96 \
-STY 	ne	ne	ne	8C 	ne	ne	ne	84 	94 \
-TAX 	AA 	ne	ne	ne	ne	ne	ne	ne	ne \
-TAY 	A8 	ne	ne	ne	ne	ne	ne	ne	ne \
-TSX 	BA 	ne	ne	ne	ne	ne	ne	ne	ne \
-TXA 	8A 	ne	ne	ne	ne	ne	ne	ne	ne \
-TXS 	9A 	ne	ne	ne	ne	ne	ne	ne	ne \
-TYA 	98 	ne	ne	ne	ne	ne	ne	ne	ne \
-";
+	return std::find(rel_opcodes.begin(), rel_opcodes.end(), name) != rel_opcodes.end();	
 }
 
-std::string opcodes::getIllegalOpcodesList()
+std::string opcodes::getCyclesList()
 {
+	// base cycles by opcode byte, '+' marks an extra cycle on page crossing
 	return "\
-SLO 	ne 	03	13	0F 	1F	ne	1B	07 	17 \
-RLA 	ne 	23	33	2F 	3F 	ne	3B	27 	37 \
-SRE 	ne 	43	53	4F	5F	ne	5B	47	57 \
-RRA 	ne 	63	73	6F	7F	ne	7B	67	77 \
-SAX 	ne	83 	ne 	8F 	ne 	ne 	ne 	87 	ne \
-LAX 	ne 	A3	B3	AF	ne	ne	BF	A7	ne \
-DCP 	ne 	C3	D3	CF	DF	ne	DB	C7	D7 \
-ISC 	ne 	E3	F3	EF	FF	ne	FB	E7	F7 \
-ANC 	ne	ne 	ne 	ne 	ne 	2B	ne 	ne 	ne \
-ALR 	ne	ne	ne	ne 	ne	4B	ne	ne 	ne \
-ARR 	ne	ne	ne	ne 	ne	6B	ne	ne 	ne \
-XAA 	ne 	ne	ne	ne	ne	8B	ne	ne	ne \
-LAX 	ne 	ne	ne	ne	ne	AB	ne	ne	ne \
-AXS 	ne 	ne	ne	ne	ne	CB	ne	ne	ne \
-SBC 	ne 	ne	ne	ne	ne	EB	ne	ne	ne \
-AHX 	ne 	ne	93	ne	ne	ne	9F	ne	ne \
-SHY 	ne 	ne	ne	ne	9C	ne	ne	ne	ne \
-SHX 	ne 	ne	ne	ne	ne	ne	9E	ne	ne \
-TAS 	ne 	ne	ne	ne	ne	ne	9B	ne	ne \
-LAS 	ne 	ne	ne	ne	ne	ne	BB	ne	ne \
+7 	6 	2 	8 	3 	3 	5 	5 	3 	2 	2 	2 	4 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
+6 	6 	2 	8 	3 	3 	5 	5 	4 	2 	2 	2 	4 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
+6 	6 	2 	8 	3 	3 	5 	5 	3 	2 	2 	2 	3 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
+6 	6 	2 	8 	3 	3 	5 	5 	4 	2 	2 	2 	5 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
+2 	6 	2 	6 	3 	3 	3 	3 	2 	2 	2 	2 	4 	4 	4 	4 	\
+2 	6 	2 	6 	4 	4 	4 	4 	2 	5 	2 	5 	5 	5 	5 	5 	\
+2 	6 	2 	6 	3 	3 	3 	3 	2 	2 	2 	2 	4 	4 	4 	4 	\
+2 	5+ 	2 	5+ 	4 	4 	4 	4 	2 	4+ 	2 	4+ 	4+ 	4+ 	4+ 	4+ 	\
+2 	6 	2 	8 	3 	3 	5 	5 	2 	2 	2 	2 	4 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
+2 	6 	2 	8 	3 	3 	5 	5 	2 	2 	2 	2 	4 	4 	6 	6 	\
+2 	5+ 	2 	8 	4 	4 	6 	6 	2 	4+ 	2 	7 	4+ 	4+ 	7 	7 	\
 ";
 }
\ No newline at end of file
@@ -1,3 +1,7 @@
+#pragma once
+
+#include "optable.hpp"
+
 #include <algorithm>
 #include <iostream>
 #include <fstream>
@@ -17,10 +21,37 @@ enum OPCODE_TYPE
 	ABSY,
 	ZP,
 	ZPX,
+	ZPY,
+	IND,
+	REL,
+};
+
+struct opcode_info
+{
+	std::string name;
+	OPCODE_TYPE type;
+	int size;
+	int cycles;
+	bool page_cycle;
+	bool illegal;
 };
 
 const std::string ERROR_ILLEGAL_OPERAND_SIGN_OP = "eo"; 
 
+// upper case hex, zero padded to width digits
+std::string hexNum(size_t v, size_t width);
+
+// parsed once per process and shared by every opcodes instance
+struct opcode_table
+{
+	std::map<const std::pair<std::string, OPCODE_TYPE>, std::string> legal;
+	std::map<const std::pair<std::string, OPCODE_TYPE>, std::string> illegal;
+	std::vector<std::string> legal_names;
+	std::vector<std::string> illegal_names;
+
+	opcode_info decode[256];
+};
+
 class opcodes
 {
 public:
@@ -28,16 +59,22 @@ public:
 	std::string getOpcode(std::string name, OPCODE_TYPE addr_type);
 
 	bool isKeyword(std::string name);
-	bool isRelativeKeyword(std::string name);
+	static bool isRelativeKeyword(std::string name);
+
+	// decoding by opcode byte, covers legal and illegal opcodes
+	opcode_info getOpcodeInfo(unsigned char code);
+	// zero page form of an absolute opcode (hex), "" when there is none
+	std::string getZeroPageOpcode(std::string abs);
 
 	void initIllegalOpcodes();
 private:
-	void initOpcodes();
-	std::map<const std::pair<std::string, OPCODE_TYPE>, std::string> opcode;
-	std::vector<std::string> opcode_names;
+	const opcode_table& table;
+	bool use_illegal = false;
 
-	std::vector<std::string> rel_opcodes = {"BCC", "BCS", "BEQ", "BMI", "BNE", "BPL", "BVC", "BVS"};
+	static const opcode_table& sharedTable();
+	static void readList(const opcode_row* rows, size_t count, std::map<const std::pair<std::string, OPCODE_TYPE>, std::string>& codes,
+		std::vector<std::string>& names);
+	static void initDecodeTable(opcode_table& t);
 
-	std::string getOpcodesList();
-	std::string getIllegalOpcodesList();
+	static std::string getCyclesList();
 };
\ No newline at end of file
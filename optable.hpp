@@ -0,0 +1,99 @@
+#pragma once
+
+// 6502 opcodes by mnemonic, -1 where there is none. The columns follow
+// OPCODE_TYPE up to ZPX: implied/accumulator, (zp,X), (zp),Y, abs, abs,X, #imm,
+// abs,Y, zp, zp,X. Branches keep their relative opcode and JMP its (ind) one in
+// the implied column, LDX and STX their zp,Y one in the zp,X column.
+// Plain C++ so that the assembler and codegen.hpp share it
+
+const int OPCODE_COLUMNS = 9;
+
+struct opcode_row
+{
+	const char* name;
+	short codes[OPCODE_COLUMNS];
+};
+
+constexpr opcode_row LEGAL_OPCODES[] =
+{
+	{"ADC", {  -1, 0x61, 0x71, 0x6D, 0x7D, 0x69, 0x79, 0x65, 0x75}},
+	{"AND", {  -1, 0x21, 0x31, 0x2D, 0x3D, 0x29, 0x39, 0x25, 0x35}},
+	{"ASL", {0x0A,   -1,   -1, 0x0E, 0x1E,   -1,   -1, 0x06, 0x16}},
+	{"BCC", {0x90,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BCS", {0xB0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BEQ", {0xF0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BIT", {  -1,   -1,   -1, 0x2C,   -1,   -1,   -1, 0x24,   -1}},
+	{"BMI", {0x30,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BNE", {0xD0,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BPL", {0x10,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BRK", {0x00,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BVC", {0x50,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"BVS", {0x70,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"CLC", {0x18,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"CLD", {0xD8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"CLI", {0x58,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"CLV", {0xB8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"CMP", {  -1, 0xC1, 0xD1, 0xCD, 0xDD, 0xC9, 0xD9, 0xC5, 0xD5}},
+	{"CPX", {  -1,   -1,   -1, 0xEC,   -1, 0xE0,   -1, 0xE4,   -1}},
+	{"CPY", {  -1,   -1,   -1, 0xCC,   -1, 0xC0,   -1, 0xC4,   -1}},
+	{"DEC", {  -1,   -1,   -1, 0xCE, 0xDE,   -1,   -1, 0xC6, 0xD6}},
+	{"DEX", {0xCA,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"DEY", {0x88,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"EOR", {  -1, 0x41, 0x51, 0x4D, 0x5D, 0x49, 0x59, 0x45, 0x55}},
+	{"INC", {  -1,   -1,   -1, 0xEE, 0xFE,   -1,   -1, 0xE6, 0xF6}},
+	{"INX", {0xE8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"INY", {0xC8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"JMP", {0x6C,   -1,   -1, 0x4C,   -1,   -1,   -1,   -1,   -1}},
+	{"JSR", {  -1,   -1,   -1, 0x20,   -1,   -1,   -1,   -1,   -1}},
+	{"LDA", {  -1, 0xA1, 0xB1, 0xAD, 0xBD, 0xA9, 0xB9, 0xA5, 0xB5}},
+	{"LDX", {  -1,   -1,   -1, 0xAE,   -1, 0xA2, 0xBE, 0xA6, 0xB6}},
+	{"LDY", {  -1,   -1,   -1, 0xAC, 0xBC, 0xA0,   -1, 0xA4, 0xB4}},
+	{"LSR", {0x4A,   -1,   -1, 0x4E, 0x5E,   -1,   -1, 0x46, 0x56}},
+	{"NOP", {0xEA,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"ORA", {  -1, 0x01, 0x11, 0x0D, 0x1D, 0x09, 0x19, 0x05, 0x15}},
+	{"PHA", {0x48,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"PHP", {0x08,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"PLA", {0x68,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"PLP", {0x28,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"ROL", {0x2A,   -1,   -1, 0x2E, 0x3E,   -1,   -1, 0x26, 0x36}},
+	{"ROR", {0x6A,   -1,   -1, 0x6E, 0x7E,   -1,   -1, 0x66, 0x76}},
+	{"RTI", {0x40,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"RTS", {0x60,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"SBC", {  -1, 0xE1, 0xF1, 0xED, 0xFD, 0xE9, 0xF9, 0xE5, 0xF5}},
+	{"SEC", {0x38,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"SED", {0xF8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"SEI", {0x78,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"STA", {  -1, 0x81, 0x91, 0x8D, 0x9D,   -1, 0x99, 0x85, 0x95}},
+	{"STX", {  -1,   -1,   -1, 0x8E,   -1,   -1,   -1, 0x86, 0x96}},
+	{"STY", {  -1,   -1,   -1, 0x8C,   -1,   -1,   -1, 0x84, 0x94}},
+	{"TAX", {0xAA,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"TAY", {0xA8,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"TSX", {0xBA,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"TXA", {0x8A,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"TXS", {0x9A,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+	{"TYA", {0x98,   -1,   -1,   -1,   -1,   -1,   -1,   -1,   -1}},
+};
+
+constexpr opcode_row ILLEGAL_OPCODES[] =
+{
+	{"SLO", {  -1, 0x03, 0x13, 0x0F, 0x1F,   -1, 0x1B, 0x07, 0x17}},
+	{"RLA", {  -1, 0x23, 0x33, 0x2F, 0x3F,   -1, 0x3B, 0x27, 0x37}},
+	{"SRE", {  -1, 0x43, 0x53, 0x4F, 0x5F,   -1, 0x5B, 0x47, 0x57}},
+	{"RRA", {  -1, 0x63, 0x73, 0x6F, 0x7F,   -1, 0x7B, 0x67, 0x77}},
+	{"SAX", {  -1, 0x83,   -1, 0x8F,   -1,   -1,   -1, 0x87,   -1}},
+	{"LAX", {  -1, 0xA3, 0xB3, 0xAF,   -1,   -1, 0xBF, 0xA7,   -1}},
+	{"DCP", {  -1, 0xC3, 0xD3, 0xCF, 0xDF,   -1, 0xDB, 0xC7, 0xD7}},
+	{"ISC", {  -1, 0xE3, 0xF3, 0xEF, 0xFF,   -1, 0xFB, 0xE7, 0xF7}},
+	{"ANC", {  -1,   -1,   -1,   -1,   -1, 0x2B,   -1,   -1,   -1}},
+	{"ALR", {  -1,   -1,   -1,   -1,   -1, 0x4B,   -1,   -1,   -1}},
+	{"ARR", {  -1,   -1,   -1,   -1,   -1, 0x6B,   -1,   -1,   -1}},
+	{"XAA", {  -1,   -1,   -1,   -1,   -1, 0x8B,   -1,   -1,   -1}},
+	{"LAX", {  -1,   -1,   -1,   -1,   -1, 0xAB,   -1,   -1,   -1}},
+	{"AXS", {  -1,   -1,   -1,   -1,   -1, 0xCB,   -1,   -1,   -1}},
+	{"SBC", {  -1,   -1,   -1,   -1,   -1, 0xEB,   -1,   -1,   -1}},
+	{"AHX", {  -1,   -1, 0x93,   -1,   -1,   -1, 0x9F,   -1,   -1}},
+	{"SHY", {  -1,   -1,   -1,   -1, 0x9C,   -1,   -1,   -1,   -1}},
+	{"SHX", {  -1,   -1,   -1,   -1,   -1,   -1, 0x9E,   -1,   -1}},
+	{"TAS", {  -1,   -1,   -1,   -1,   -1,   -1, 0x9B,   -1,   -1}},
+	{"LAS", {  -1,   -1,   -1,   -1,   -1,   -1, 0xBB,   -1,   -1}},
+};
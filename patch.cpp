@@ -0,0 +1,155 @@
+#include "patch.hpp"
+
+bool patch::isFormat(std::string format)
+{
+	return format == "ips" || format == "bps";
+}
+
+std::string patch::getError()
+{
+	return error;
+}
+
+bool patch::make(std::string format, const std::string& from, const std::string& to, std::string& out)
+{
+	if(!isFormat(format))
+	{
+		error = "unknown patch format " + format;
+		return false;
+	}
+
+	out = "";
+
+	if(format == "ips")
+		return ips(from, to, out);
+
+	bps(from, to, out);
+	return true;
+}
+
+bool patch::ips(const std::string& from, const std::string& to, std::string& out)
+{
+	if(to.size() > IPS_MAX_SIZE || from.size() > IPS_MAX_SIZE)
+	{
+		error = "IPS can't address ROMs over 16 MB";
+		return false;
+	}
+
+	auto same = [&](size_t i)
+	{
+		return i < from.size() && from[i] == to[i];
+	};
+
+	out += "PATCH";
+
+	for(size_t i(0); i < to.size();)
+	{
+		if(same(i))
+		{
+			i++;
+			continue;
+		}
+
+		size_t start = i == IPS_EOF_OFFSET ? i-1 : i;
+		size_t end = start;
+
+		// unchanged runs shorter than a record header go along
+		for(size_t run = 0; i < to.size() && i - start < IPS_MAX_RECORD; i++)
+		{
+			if(!same(i))
+			{
+				end = i+1;
+				run = 0;
+			}
+
+			else if(++run > IPS_RECORD_HEADER)
+				break;
+		}
+
+		i = end;
+
+		out += (char)(start >> 16);
+		out += (char)(start >> 8);
+		out += (char)start;
+		out += (char)((end - start) >> 8);
+		out += (char)(end - start);
+		out += to.substr(start, end - start);
+	}
+
+	out += "EOF";
+
+	if(to.size() < from.size())
+	{
+		out += (char)(to.size() >> 16);
+		out += (char)(to.size() >> 8);
+		out += (char)to.size();
+	}
+
+	return true;
+}
+
+void patch::bps(const std::string& from, const std::string& to, std::string& out)
+{
+	out += "BPS1";
+	putNumber(from.size(), out);
+	putNumber(to.size(), out);
+	// no metadata
+	putNumber(0, out);
+
+	for(size_t i(0); i < to.size();)
+	{
+		bool same = i < from.size() && from[i] == to[i];
+		size_t j = i;
+
+		while(j < to.size() && (j < from.size() && from[j] == to[j]) == same)
+			j++;
+
+		putNumber(((j - i - 1) << 2) | (same ? BPS_SOURCE_READ : BPS_TARGET_READ), out);
+
+		if(!same)
+			out += to.substr(i, j - i);
+
+		i = j;
+	}
+
+	putCrc(from, out);
+	putCrc(to, out);
+	putCrc(out, out);
+}
+
+void patch::putNumber(uint64_t v, std::string& out)
+{
+	// 7 bits per byte, the last one has bit 7 set
+	while(true)
+	{
+		uint8_t x = v & 0x7F;
+		v >>= 7;
+
+		if(v == 0)
+		{
+			out += (char)(0x80 | x);
+			return;
+		}
+
+		out += (char)x;
+		v--;
+	}
+}
+
+void patch::putCrc(const std::string& data, std::string& out)
+{
+	uint32_t crc = 0xFFFFFFFF;
+
+	for(unsigned char c : data)
+	{
+		crc ^= c;
+
+		for(int k(0); k < 8; k++)
+			crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+	}
+
+	crc = ~crc;
+
+	for(int k(0); k < 4; k++)
+		out += (char)(crc >> (8*k));
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// IPS offsets are 3 bytes, "EOF" as an offset ends the patch
+const size_t IPS_MAX_SIZE = 0x1000000;
+const size_t IPS_EOF_OFFSET = 0x454F46;
+const size_t IPS_MAX_RECORD = 0xFFFF;
+const size_t IPS_RECORD_HEADER = 5;
+
+const size_t BPS_SOURCE_READ = 0;
+const size_t BPS_TARGET_READ = 1;
+
+// patches from the previous ROM to the new one:
+// ips - "PATCH", records of offset (3 bytes), size (2) and the new bytes,
+//       "EOF" and the new size (3 bytes) when the ROM got shorter
+// bps - "BPS1", sizes, source reads for unchanged runs and target reads
+//       with the new bytes, CRC32 of the source, target and patch
+class patch
+{
+public:
+	static bool isFormat(std::string format);
+
+	bool make(std::string format, const std::string& from, const std::string& to, std::string& out);
+	std::string getError();
+private:
+	std::string error;
+
+	bool ips(const std::string& from, const std::string& to, std::string& out);
+	void bps(const std::string& from, const std::string& to, std::string& out);
+
+	void putNumber(uint64_t v, std::string& out);
+	void putCrc(const std::string& data, std::string& out);
+};
@@ -0,0 +1,96 @@
+#include "prefetch.hpp"
+#include "assembler.hpp"
+
+prefetcher::prefetcher(source_cache* cache, size_t threads) : cache(cache), threads(threads)
+{
+}
+
+prefetcher::~prefetcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(m);
+		stop = true;
+	}
+
+	wake.notify_all();
+
+	for(auto& w : workers)
+		w.join();
+}
+
+void prefetcher::start(std::string filename)
+{
+	if(!cache || threads == 0)
+		return;
+
+	add({filename, false});
+
+	for(size_t i(0); i < threads; i++)
+		workers.push_back(std::thread(&prefetcher::work, this));
+}
+
+void prefetcher::add(file f)
+{
+	std::lock_guard<std::mutex> lock(m);
+
+	if(seen.insert({f.name, f.binary}).second)
+		queue.push_back(f);
+}
+
+void prefetcher::scan(const std::string& line)
+{
+	// .include "file" and .incbin "file"[, compress=method]
+	bool binary = line.compare(0, 7, ".incbin") == 0;
+
+	if(!binary && line.compare(0, 8, ".include") != 0)
+		return;
+
+	size_t from = line.find('"');
+	size_t to = from == std::string::npos ? from : line.find('"', from+1);
+
+	if(to == std::string::npos)
+		return;
+
+	add({line.substr(from+1, to-from-1), binary});
+	wake.notify_one();
+}
+
+void prefetcher::work()
+{
+	while(true)
+	{
+		file f;
+
+		{
+			std::unique_lock<std::mutex> lock(m);
+
+			// done when nothing is queued and no file being read can add more
+			wake.wait(lock, [&] { return stop || !queue.empty() || busy == 0; });
+
+			if(stop || queue.empty())
+				break;
+
+			f = queue.front();
+			queue.pop_front();
+			busy++;
+		}
+
+		if(f.binary)
+			cache->getBinary(f.name);
+
+		else if(auto src = cache->getSource(f.name))
+		{
+			for(auto& l : *src)
+				scan(l.text);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m);
+			busy--;
+		}
+
+		wake.notify_all();
+	}
+
+	wake.notify_all();
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+const size_t PREFETCH_THREADS = 4;
+
+class source_cache;
+
+// reads the files a source includes into the cache on a few threads while the
+// assembler works, following .include and .incbin lines as they come in. The
+// scan only looks at the lines, so files under a false .if are read as well;
+// files that aren't there are left for the assembler to report
+class prefetcher
+{
+public:
+	prefetcher(source_cache* cache, size_t threads);
+	// stops reading new files and waits for the ones being read
+	~prefetcher();
+
+	void start(std::string filename);
+private:
+	struct file
+	{
+		std::string name;
+		bool binary;
+	};
+
+	source_cache* cache;
+	size_t threads;
+	std::vector<std::thread> workers;
+
+	std::mutex m;
+	std::condition_variable wake;
+	std::deque<file> queue;
+	std::set<std::pair<std::string, bool>> seen;
+	size_t busy = 0;
+	bool stop = false;
+
+	void add(file f);
+	void scan(const std::string& line);
+	void work();
+};
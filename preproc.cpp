@@ -5,7 +5,12 @@ preproc::preproc()
 	keywords = {".ines", ".inesprg", ".ineschr", ".inesmap", ".inesmir", ".org",
 				 ".db", "dw", "incbin", ".bank", ".rsset", ".rs",
 				 ".byte", ".word", ".use", ".include", ".list", ".nolist",
-				 ".define"};
+				 ".define", ".timed", ".endtimed", ".loop", ".table", ".tablew",
+				 ".for", ".forw", ".banksize", ".bankorg", ".align", ".nocross",
+				 ".endnocross", ".compress", ".endcompress", ".var", ".varzp", ".varram",
+				 ".export", ".pool", ".endpool",
+				 ".trampolines", ".rept", ".endr",
+				 ".reloc", ".endreloc", ".section", ".endsection"};
 }
 
 std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
@@ -14,20 +19,68 @@ std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
 	std::vector<std::string> parsed_inst((std::istream_iterator<std::string>(iss)),
                                  std::istream_iterator<std::string>());
 
+	if(parsed_inst.empty())
+		return {PREPROC_ERROR};
+
+	bad_number = false;
+
+	auto res = parseDirective(parsed_inst, inst);
+
+	if(bad_number)
+		return {PREPROC_ERROR};
+
+	return res;
+}
+
+std::vector<std::string> preproc::parseDirective(std::vector<std::string>& parsed_inst, std::string inst)
+{
+	// directives with a fixed word count check it before they look at the words
+	size_t words = parsed_inst.size();
+
+	if(words > 2 && parsed_inst[1] == ".rs")
+		return {PREPROC_RS_SIGN, parsed_inst[0], parsed_inst[2]};
+
+	if(parsed_inst[0] == ".inesprg" || parsed_inst[0] == ".ineschr" || parsed_inst[0] == ".inesmap" ||
+		parsed_inst[0] == ".inesmir" || parsed_inst[0] == ".org" || parsed_inst[0] == ".rsset" ||
+		parsed_inst[0] == ".include" || parsed_inst[0] == ".use")
+	{
+		if(words < 2)
+			return {PREPROC_ERROR};
+	}
+
 	if(parsed_inst[0] == ".inesprg")
+	{
+		makeNum(parsed_inst[1]);
 		prg = parsed_inst[1];
+	}
 
 	else if(parsed_inst[0] == ".ineschr")
+	{
+		makeNum(parsed_inst[1]);
 		chr = parsed_inst[1];
+	}
 
 	else if(parsed_inst[0] == ".inesmap")
+	{
+		checkNibbles(parsed_inst[1], 2);
 		mapper = parsed_inst[1];
+	}
 
 	else if(parsed_inst[0] == ".inesmir")
+	{
+		checkNibbles(parsed_inst[1], 1);
 		mirroring = parsed_inst[1];
+	}
 
 	else if(parsed_inst[0] == ".ines")
 	{
+		if(words < 5)
+			return {PREPROC_ERROR};
+
+		makeNum(parsed_inst[1]);
+		makeNum(parsed_inst[2]);
+		checkNibbles(parsed_inst[3], 2);
+		checkNibbles(parsed_inst[4], 1);
 		prg = parsed_inst[1];
 		chr = parsed_inst[2];
 		mapper = parsed_inst[3];
@@ -36,9 +89,101 @@ std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
 
 	else if(parsed_inst[0] == ".incbin")
 	{
-		parsed_inst[1].pop_back();
-		parsed_inst[1].erase(parsed_inst[1].begin());
-		return {PREPROC_INCBIN_SIGN, parsed_inst[1]};
+		// .incbin "file" [, compress=method]
+		auto args = splitArgs(inst);
+
+		if(args.size() < 1 || args.size() > 2 || args[0].length() < 2)
+			return {PREPROC_ERROR};
+
+		std::string method = "";
+
+		if(args.size() == 2)
+		{
+			if(args[1].compare(0, 9, "compress=") != 0 || !compression::isMethod(args[1].substr(9)))
+				return {PREPROC_ERROR};
+
+			method = args[1].substr(9);
+		}
+
+		return {PREPROC_INCBIN_SIGN, args[0].substr(1, args[0].length()-2), method};
+	}
+
+	else if(parsed_inst[0] == ".compress")
+	{
+		if(parsed_inst.size() != 2 || !compression::isMethod(parsed_inst[1]))
+			return {PREPROC_ERROR};
+
+		return {PREPROC_COMPRESS_SIGN, parsed_inst[1]};
+	}
+
+	else if(parsed_inst[0] == ".endcompress")
+	{
+		return {PREPROC_ENDCOMPRESS_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".pool")
+	{
+		return {PREPROC_POOL_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".endpool")
+	{
+		return {PREPROC_ENDPOOL_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".reloc")
+	{
+		// .reloc name, run address
+		auto args = splitArgs(inst);
+
+		if(args.size() != 2 || args[0] == "")
+			return {PREPROC_ERROR};
+
+		return {PREPROC_RELOC_SIGN, args[0], std::to_string(makeNum(args[1]))};
+	}
+
+	else if(parsed_inst[0] == ".endreloc")
+	{
+		return {PREPROC_ENDRELOC_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".section")
+	{
+		// .section name [, fixed] [, bank=N] [, with=name] [, align=N] [, nocross]
+		auto args = splitArgs(inst);
+
+		if(args.size() < 1 || args[0] == "")
+			return {PREPROC_ERROR};
+
+		std::string fixed = "0", bank = "-1", with = "", align = "1", nocross = "0";
+
+		for(size_t i(1); i < args.size(); i++)
+		{
+			if(args[i] == "fixed")
+				fixed = "1";
+			else if(args[i] == "nocross")
+				nocross = "1";
+			else if(args[i].compare(0, 5, "bank=") == 0)
+				bank = std::to_string(makeNum(args[i].substr(5)));
+			else if(args[i].compare(0, 5, "with=") == 0 && args[i].length() > 5)
+				with = args[i].substr(5);
+			else if(args[i].compare(0, 6, "align=") == 0 && makeNum(args[i].substr(6)) > 0)
+				align = std::to_string(makeNum(args[i].substr(6)));
+			else
+				return {PREPROC_ERROR};
+		}
+
+		return {PREPROC_SECTION_SIGN, args[0], fixed, bank, with, align, nocross};
+	}
+
+	else if(parsed_inst[0] == ".endsection")
+	{
+		return {PREPROC_ENDSECTION_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".trampolines")
+	{
+		return {PREPROC_TRAMPOLINES_SIGN};
 	}
 
 	else if(parsed_inst[0] == ".org")
@@ -48,7 +193,30 @@ std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
 
 	else if(parsed_inst[0] == ".bank")
 	{
-		return {PREPROC_BANK_SIGN, parsed_inst[1]};
+		// .bank N [, $window]
+		auto args = splitArgs(inst);
+
+		if(args.size() < 1 || args.size() > 2)
+			return {PREPROC_ERROR};
+
+		if(args.size() == 2)
+			return {PREPROC_BANK_SIGN, std::to_string(makeNum(args[0])), std::to_string(makeNum(args[1]))};
+
+		return {PREPROC_BANK_SIGN, std::to_string(makeNum(args[0]))};
+	}
+
+	else if(parsed_inst[0] == ".banksize")
+	{
+		if(parsed_inst.size() < 2)
+			return {PREPROC_ERROR};
+		return {PREPROC_BANKSIZE_SIGN, std::to_string(makeNum(parsed_inst[1]))};
+	}
+
+	else if(parsed_inst[0] == ".bankorg")
+	{
+		if(parsed_inst.size() < 2)
+			return {PREPROC_ERROR};
+		return {PREPROC_BANKORG_SIGN, std::to_string(makeNum(parsed_inst[1]))};
 	}
 
 	else if(parsed_inst[0] == ".list")
@@ -68,19 +236,104 @@ std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
 
 	else if(parsed_inst[0] == ".define")
 	{
+		if(words < 3)
+			return {PREPROC_ERROR};
 		return {PREPROC_DEFINE_SIGN, parsed_inst[1], parsed_inst[2]};
 	}
 
-	else if(parsed_inst[1] == ".rs")
+	else if(parsed_inst[0] == ".timed")
 	{
-		return {PREPROC_RS_SIGN, parsed_inst[0], parsed_inst[2]};
+		if(parsed_inst.size() < 2)
+			return {PREPROC_ERROR};
+		return {PREPROC_TIMED_SIGN, std::to_string(makeNum(parsed_inst[1]))};
+	}
+
+	else if(parsed_inst[0] == ".endtimed")
+	{
+		return {PREPROC_ENDTIMED_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".loop")
+	{
+		if(parsed_inst.size() < 2)
+			return {PREPROC_ERROR};
+		return {PREPROC_LOOP_SIGN, std::to_string(makeNum(parsed_inst[1]))};
+	}
+
+	else if(parsed_inst[0] == ".align")
+	{
+		// .align N [, fill]
+		auto args = splitArgs(inst);
+
+		if(args.size() < 1 || args.size() > 2)
+			return {PREPROC_ERROR};
+
+		int n = makeNum(args[0]);
+		int fill = args.size() == 2 ? makeNum(args[1]) : 0xFF;
+
+		if(n <= 0 || fill < 0 || fill > 0xFF)
+			return {PREPROC_ERROR};
+
+		return {PREPROC_ALIGN_SIGN, std::to_string(n), hexNum(fill, 2)};
+	}
+
+	else if(parsed_inst[0] == ".nocross")
+	{
+		// .nocross [warn]
+		if(parsed_inst.size() > 2 || (parsed_inst.size() == 2 && parsed_inst[1] != "warn"))
+			return {PREPROC_ERROR};
+
+		return {PREPROC_NOCROSS_SIGN, parsed_inst.size() == 2 ? "1" : "0"};
+	}
+
+	else if(parsed_inst[0] == ".endnocross")
+	{
+		return {PREPROC_ENDNOCROSS_SIGN};
+	}
+
+	else if(parsed_inst[0] == ".var")
+	{
+		// .var name, size [, zp|ram]
+		auto args = splitArgs(inst);
+
+		if(args.size() < 2 || args.size() > 3 || (args.size() == 3 && args[2] != "zp" && args[2] != "ram"))
+			return {PREPROC_ERROR};
+
+		return {PREPROC_VAR_SIGN, args[0], std::to_string(makeNum(args[1])), args.size() == 3 ? args[2] : ""};
+	}
+
+	else if(parsed_inst[0] == ".varzp" || parsed_inst[0] == ".varram")
+	{
+		auto args = splitArgs(inst);
+
+		if(args.size() != 2)
+			return {PREPROC_ERROR};
+
+		return {parsed_inst[0] == ".varzp" ? PREPROC_VARZP_SIGN : PREPROC_VARRAM_SIGN,
+			std::to_string(makeNum(args[0])), std::to_string(makeNum(args[1]))};
+	}
+
+	else if(parsed_inst[0] == ".export")
+	{
+		// .export name [, name...]
+		auto args = splitArgs(inst);
+
+		if(args.empty())
+			return {PREPROC_ERROR};
+
+		args.insert(args.begin(), PREPROC_EXPORT_SIGN);
+		return args;
 	}
 
 	else if(parsed_inst[0] == ".include")
 	{
-		parsed_inst[1].pop_back();
-		parsed_inst[1].erase(parsed_inst[1].begin());
-		return {PREPROC_INCLUDE_SIGN, parsed_inst[1]};
+		// .include "file", the name may have spaces
+		auto args = splitArgs(inst);
+
+		if(args.size() != 1 || args[0].length() < 2 || args[0].front() != '"' || args[0].back() != '"')
+			return {PREPROC_ERROR};
+
+		return {PREPROC_INCLUDE_SIGN, args[0].substr(1, args[0].length()-2)};
 	}
 
 	else if(parsed_inst[0] == ".use")
@@ -93,118 +346,190 @@ std::vector<std::string> preproc::parsePreprocInstruction(std::string inst)
 			return {PREPROC_ERROR};
 	}
 
-	else if(parsed_inst[0] == ".db" || parsed_inst[0] == ".byte")
+	else if(parsed_inst[0] == ".db" || parsed_inst[0] == ".byte" || parsed_inst[0] == ".dw" || parsed_inst[0] == ".word")
 	{
+		bool word = parsed_inst[0] == ".dw" || parsed_inst[0] == ".word";
 		std::vector<std::string> args;
+		std::map<std::string, size_t> none;
 
-		args.push_back(PREPROC_DB_SIGN);
+		args.push_back(word ? PREPROC_DW_SIGN : PREPROC_DB_SIGN);
 
-		for(size_t i(1); i < parsed_inst.size(); i++)
+		for(auto i : splitArgs(inst))
 		{
-			if(i != parsed_inst.size()-1)
-				parsed_inst[i].pop_back();
-			OPERAND_TYPE t = ins.getOperandType(parsed_inst[i]);
+			if(i == "")
+				return {PREPROC_ERROR};
+
+			if(i[0] == '#')
+				i.erase(i.begin());
+
+			long v;
 
-			if(t == OPERAND_TYPE::ADDRESS)
+			// anything with symbols is evaluated in pass 2, values out of range as
+			// well so the range check there reports them
+			if(!ex.evaluate(i, none, v))
 			{
-				std::string tmp = ins.convertToHex("#"+parsed_inst[i], ins.isNumber("#"+parsed_inst[i]), false);
+				if(!ex.isUndefined())
+					return {PREPROC_ERROR};
 
-				while(tmp.length() < 2)
-					tmp = "0" + tmp;
+				args.push_back(PREPROC_EXPR_PREFIX + i);
+			}
+
+			else if(v < (word ? -0x8000 : -0x80) || v > (word ? 0xFFFF : 0xFF))
+				args.push_back(PREPROC_EXPR_PREFIX + i);
 
-				args.push_back(tmp);
+			else if(word)
+			{
+				std::string tmp = hexNum(v & 0xFFFF, 4);
+				args.push_back(tmp.substr(2, 2) + tmp.substr(0, 2));
 			}
+
+			else
+				args.push_back(hexNum(v & 0xFF, 2));
 		}
 
 		return args;
 	}
 
-	else if(parsed_inst[0] == ".dw" || parsed_inst[0] == ".word")
+	else if(parsed_inst[0] == ".table" || parsed_inst[0] == ".tablew")
 	{
-		if(ins.getOperandType(parsed_inst[1]) == OPERAND_TYPE::LABEL)
-			return {PREPROC_DW_LABEL_SIGN, parsed_inst[1]};
+		auto args = splitArgs(inst);
 
-		std::vector<std::string> args;
+		if(args.size() != 2)
+			return {PREPROC_ERROR};
 
-		args.push_back(PREPROC_DW_SIGN);
+		return {PREPROC_TABLE_SIGN, parsed_inst[0] == ".table" ? "1" : "2", "i", "0", "(" + args[0] + ")-1", args[1]};
+	}
 
-		for(size_t i(1); i < parsed_inst.size(); i++)
-		{
-			if(i != parsed_inst.size()-1)
-				parsed_inst[i].pop_back();
-			OPERAND_TYPE t = ins.getOperandType(parsed_inst[i]);
+	else if(parsed_inst[0] == ".for" || parsed_inst[0] == ".forw")
+	{
+		auto args = splitArgs(inst);
 
-			if(t == OPERAND_TYPE::ADDRESS)
-			{
-				std::string tmp = ins.convertToHex("#"+parsed_inst[i], ins.isNumber("#"+parsed_inst[i]), false);
+		if(args.size() != 4)
+			return {PREPROC_ERROR};
 
-				while(tmp.length() < 4)
-					tmp = "0" + tmp;
+		return {PREPROC_TABLE_SIGN, parsed_inst[0] == ".for" ? "1" : "2", args[0], args[1], args[2], args[3]};
+	}
 
-				std::string adr = std::string(1,tmp[2]) + std::string(1,tmp[3]);
-				adr += std::string(1,tmp[0]) + std::string(1,tmp[1]);
+	else
+		return {PREPROC_ERROR};
 
-				args.push_back(adr);
-			}
-		}
+	return {PREPROC_DONE};
+}
+
+std::vector<std::string> preproc::splitArgs(std::string inst)
+{
+	std::vector<std::string> args;
+	std::string cur = "";
+	int depth = 0;
+	bool quoted = false;
 
+	size_t i = inst.find_first_of(" \t");
+
+	if(i == std::string::npos)
 		return args;
+
+	for(; i < inst.length(); i++)
+	{
+		char c = inst[i];
+
+		if(c == '"')
+			quoted = !quoted;
+		else if(c == '(' && !quoted)
+			depth++;
+		else if(c == ')' && !quoted)
+			depth--;
+
+		if(c == ',' && depth == 0 && !quoted)
+		{
+			args.push_back(cur);
+			cur = "";
+			continue;
+		}
+
+		if((c == ' ' || c == '\t') && !quoted)
+			continue;
+
+		cur += c;
 	}
 
-	else
-		return {PREPROC_ERROR};
+	if(cur != "" || args.size() > 0)
+		args.push_back(cur);
 
-	return {PREPROC_DONE};
+	return args;
 }
 
 std::string preproc::makeHeader()
 {
 	std::string header = "";
-	std::string mp = makeHex(mapper);
+	int prg_units = makeNum(prg);
+	int chr_units = makeNum(chr);
+
+	// more than 255 units (4 MB PRG) needs the NES 2.0 size nibbles
+	bool nes2 = prg_units > 0xFF || chr_units > 0xFF;
 
 	header += HEADER_START;
-	header += makeHex(prg);
-	header += makeHex(chr);
-	header += mapper.length() == 1 ? std::string(1, mapper[0]) : std::string(1, mapper[1]);
-	header += mirroring;
-	header += mapper.length() == 1 ? std::string(1, '0') : std::string(1, mapper[0]);
-	header += "0";
+	header += hexNum(prg_units & 0xFF, 2);
+	header += hexNum(chr_units & 0xFF, 2);
+	// a source without .ines still gets a header the rom can parse
+	std::string map = mapper == "" ? "0" : mapper;
+
+	header += map.length() == 1 ? std::string(1, map[0]) : std::string(1, map[1]);
+	header += mirroring == "" ? "0" : mirroring;
+	header += map.length() == 1 ? std::string(1, '0') : std::string(1, map[0]);
+	header += nes2 ? "8" : "0";
 
-	header += "0000000000000000";
+	header += "00";
+	header += hexNum((chr_units >> 8) & 0xF, 1) + hexNum((prg_units >> 8) & 0xF, 1);
+	header += "000000000000";
 
 	return header;
 }
 
 int preproc::makeDec(std::string w)
 {
-	w.erase(w.begin());
-	std::stringstream s;
-	size_t n;
-	s << std::hex << w;
-	s >> n;
+	if(w.length() < 2 || w.length() > 9 || w.find_first_not_of("0123456789ABCDEFabcdef", 1) != std::string::npos)
+	{
+		bad_number = true;
+		return 0;
+	}
 
-	return n;
+	return std::stoll(w.substr(1), 0, 16);
 }
 
-int preproc::getChrSizeKb()
+int preproc::makeNum(std::string w)
 {
-	return std::stoi(chr)*8;
+	if(w != "" && w[0] == '$')
+		return makeDec(w);
+
+	size_t digits = w != "" && w[0] == '-' ? 1 : 0;
+
+	if(w.length() == digits || w.length() > digits + 9 || w.find_first_not_of("0123456789", digits) != std::string::npos)
+	{
+		bad_number = true;
+		return 0;
+	}
+
+	return std::stoi(w);
 }
 
-bool preproc::isPreprocKeyword(std::string key)
+void preproc::checkNibbles(std::string w, size_t most)
 {
-	return std::find(keywords.begin(), keywords.end(), key) != keywords.end();
+	// header fields that go into the header as written
+	if(w.empty() || w.length() > most || w.find_first_not_of("0123456789ABCDEFabcdef") != std::string::npos)
+		bad_number = true;
 }
 
-std::string preproc::makeHex(std::string w)
+int preproc::getChrSizeKb()
 {
-	std::stringstream s;
-	s << std::hex << std::uppercase << std::stoi(w);
-
-	auto n = s.str();
+	return makeNum(chr)*8;
+}
 
-	if(n.length() < 2)
-		n = "0" + n;
+int preproc::getMapper()
+{
+	return mapper == "" ? 0 : makeNum(mapper);
+}
 
-	return n;
+bool preproc::isPreprocKeyword(std::string key)
+{
+	return std::find(keywords.begin(), keywords.end(), key) != keywords.end();
 }
\ No newline at end of file
@@ -6,6 +6,8 @@
 #include <algorithm>
 
 #include "instructions.hpp"
+#include "expressions.hpp"
+#include "compression.hpp"
 
 const std::string HEADER_START = "4E45531A";
 
@@ -13,16 +15,20 @@ const std::string PREPROC_ERROR = "-1";
 const std::string PREPROC_DONE = "0";
 
 const std::string PREPROC_BANK_SIGN = "b";
+const std::string PREPROC_BANKSIZE_SIGN = "bs";
+const std::string PREPROC_BANKORG_SIGN = "bo";
 
 const std::string PREPROC_OFFSET_SIGN = "o";
 const std::string PREPROC_DB_SIGN = "db";
 const std::string PREPROC_DW_SIGN = "dw";
-const std::string PREPROC_DW_LABEL_SIGN = "dwl";
+const std::string PREPROC_TABLE_SIGN = "tb";
 const std::string PREPROC_RSSET_SIGN = "rss";
 const std::string PREPROC_RS_SIGN = "rs";
 
 const std::string PREPROC_INCLUDE_SIGN = "ic";
 const std::string PREPROC_INCBIN_SIGN = "ib";
+const std::string PREPROC_COMPRESS_SIGN = "cp";
+const std::string PREPROC_ENDCOMPRESS_SIGN = "ecp";
 
 const std::string PREPROC_LIST_SIGN = "lst";
 const std::string PREPROC_NOLIST_SIGN = "nlst";
@@ -32,21 +38,64 @@ const std::string PREPROC_USE_DEFS_SIGN = "ud";
 
 const std::string PREPROC_DEFINE_SIGN = "df";
 
+const std::string PREPROC_TIMED_SIGN = "tm";
+const std::string PREPROC_ENDTIMED_SIGN = "etm";
+const std::string PREPROC_LOOP_SIGN = "lp";
+
+const std::string PREPROC_ALIGN_SIGN = "al";
+const std::string PREPROC_NOCROSS_SIGN = "nc";
+const std::string PREPROC_ENDNOCROSS_SIGN = "enc";
+
+const std::string PREPROC_VAR_SIGN = "vr";
+const std::string PREPROC_VARZP_SIGN = "vz";
+const std::string PREPROC_VARRAM_SIGN = "vm";
+
+const std::string PREPROC_EXPORT_SIGN = "ex";
+
+const std::string PREPROC_POOL_SIGN = "pl";
+const std::string PREPROC_ENDPOOL_SIGN = "epl";
+
+const std::string PREPROC_TRAMPOLINES_SIGN = "tr";
+
+const std::string PREPROC_RELOC_SIGN = "rl";
+const std::string PREPROC_ENDRELOC_SIGN = "erl";
+
+const std::string PREPROC_SECTION_SIGN = "sc";
+const std::string PREPROC_ENDSECTION_SIGN = "esc";
+
+// .db/.dw items that wait for pass 2
+const std::string PREPROC_EXPR_PREFIX = "=";
+
 class preproc
 {
 public:
 	preproc();
 
+	// {PREPROC_ERROR} for missing arguments and numbers that don't parse
 	std::vector<std::string> parsePreprocInstruction(std::string inst);
 	std::string makeHeader();
 
 	bool isPreprocKeyword(std::string key);
 
 	int getChrSizeKb();
+	// iNES mapper number, 0 when none is set
+	int getMapper();
+
+	// comma separated arguments after the directive, spaces dropped
+	static std::vector<std::string> splitArgs(std::string inst);
 
+	// $hex, 0 when it isn't a number, which fails the line being parsed
 	int makeDec(std::string w);
+	// decimal or $hex
+	int makeNum(std::string w);
 private:
+	bool bad_number = false;
+
+	// sets bad_number unless w is 1 to most hex digits
+	void checkNibbles(std::string w, size_t most);
+	std::vector<std::string> parseDirective(std::vector<std::string>& parsed_inst, std::string inst);
 	instructions ins;
+	expressions ex;
 
 	std::vector<std::string> keywords;
 
@@ -54,7 +103,4 @@ private:
 	std::string chr; 
 	std::string mapper;
 	std::string mirroring;
-
-	std::string makeHex(std::string w);
-
 };
\ No newline at end of file
@@ -0,0 +1,136 @@
+#include "rom.hpp"
+
+bool rom::setBankSizeKb(size_t kb)
+{
+	if((kb != 8 && kb != 16 && kb != 32) || banks.size() > 0)
+		return false;
+
+	bank_size = kb*1024;
+	return true;
+}
+
+size_t rom::getBankSize()
+{
+	return bank_size;
+}
+
+void rom::setDefaultWindow(size_t address)
+{
+	default_window_set = true;
+	default_window = address;
+}
+
+size_t rom::getDefaultWindow(size_t bank)
+{
+	if(default_window_set)
+		return default_window;
+
+	return ROM_START_ADR + bank*bank_size;
+}
+
+void rom::setWindow(size_t bank, size_t address)
+{
+	windows[bank] = address;
+}
+
+size_t rom::getWindow(size_t bank)
+{
+	auto w = windows.find(bank);
+
+	if(w == windows.end())
+		return getDefaultWindow(bank);
+
+	return w->second;
+}
+
+void rom::use(size_t bank)
+{
+	banks[bank];
+}
+
+bool rom::isUsed(size_t bank)
+{
+	return banks.find(bank) != banks.end();
+}
+
+std::vector<size_t> rom::getUsedBanks()
+{
+	std::vector<size_t> used;
+
+	for(auto& b : banks)
+		used.push_back(b.first);
+
+	return used;
+}
+
+const std::vector<unsigned char>& rom::getBank(size_t bank)
+{
+	return banks[bank];
+}
+
+std::vector<unsigned char>& rom::reserve(size_t bank, size_t offset, size_t length)
+{
+	auto& b = banks[bank];
+
+	if(b.size() < offset + length)
+		b.resize(offset + length, 0xFF);
+
+	return b;
+}
+
+size_t rom::write(size_t bank, size_t offset, std::string hex)
+{
+	size_t n = hex.length()/2;
+	auto& b = reserve(bank, offset, n);
+
+	for(size_t i(0); i < n; i++)
+		b[offset+i] = std::stoi(hex.substr(i*2, 2), 0, 16);
+
+	return n;
+}
+
+size_t rom::writeBytes(size_t bank, size_t offset, std::string data)
+{
+	auto& b = reserve(bank, offset, data.size());
+
+	std::copy(data.begin(), data.end(), b.begin() + offset);
+
+	return data.size();
+}
+
+std::string rom::makeImage(std::string header)
+{
+	std::string image = "";
+
+	for(size_t i(0); i+1 < header.length(); i += 2)
+		image += (char)std::stoi(header.substr(i, 2), 0, 16);
+
+	size_t next = 0;
+
+	for(auto& b : banks)
+	{
+		image.append((b.first - next) * bank_size, (char)0xFF);
+		image.append((const char*)b.second.data(), b.second.size());
+
+		// an overlong bank (usually CHR data) runs into the next ones
+		if(b.second.size() < bank_size)
+			image.append(bank_size - b.second.size(), (char)0xFF);
+
+		next = b.first+1;
+	}
+
+	return image;
+}
+
+bool rom::writeFile(std::string filename, std::string header)
+{
+	std::ofstream output(filename, std::ios::binary);
+
+	if(!output.good())
+		return false;
+
+	std::string image = makeImage(header);
+	output.write(image.data(), image.size());
+
+	return output.good();
+}
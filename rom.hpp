@@ -0,0 +1,48 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <map>
+
+const size_t ROM_START_ADR = 0xC000;
+
+// .bank contents by bank number, only the banks that are used are stored
+class rom
+{
+public:
+	// 8, 16 or 32 KB, before the first .bank
+	bool setBankSizeKb(size_t kb);
+	size_t getBankSize();
+
+	// CPU window of banks without an explicit one (.bankorg),
+	// by default bank N sits at $C000 + N*bank size
+	void setDefaultWindow(size_t address);
+	size_t getDefaultWindow(size_t bank);
+
+	void setWindow(size_t bank, size_t address);
+	size_t getWindow(size_t bank);
+
+	void use(size_t bank);
+	bool isUsed(size_t bank);
+	std::vector<size_t> getUsedBanks();
+	const std::vector<unsigned char>& getBank(size_t bank);
+
+	// hex byte pairs at offset, a gap before offset is filled with $FF,
+	// returns the number of bytes written
+	size_t write(size_t bank, size_t offset, std::string hex);
+	size_t writeBytes(size_t bank, size_t offset, std::string data);
+
+	// iNES header and the banks up to the highest used one, unused space is $FF
+	std::string makeImage(std::string header);
+	bool writeFile(std::string filename, std::string header);
+private:
+	size_t bank_size = 0x2000;
+	bool default_window_set = false;
+	size_t default_window = 0;
+
+	std::map<size_t, size_t> windows;
+	std::map<size_t, std::vector<unsigned char>> banks;
+
+	std::vector<unsigned char>& reserve(size_t bank, size_t offset, size_t length);
+};
@@ -0,0 +1,378 @@
+#include "sections.hpp"
+#include "opcodes.hpp"
+
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+
+void sections::addBank(size_t bank, size_t window, size_t size)
+{
+	banks[bank].window = window;
+	banks[bank].size = size;
+}
+
+bool sections::occupy(size_t bank, size_t from, size_t to)
+{
+	if(from >= to)
+		return true;
+
+	auto& used = banks[bank].used;
+	auto next = used.upper_bound(from);
+
+	if(next != used.end() && next->first < to)
+		return false;
+
+	if(next != used.begin())
+	{
+		auto prev = std::prev(next);
+
+		if(prev->second > from)
+			return false;
+
+		// code laid out in a row is one range
+		if(prev->second == from)
+		{
+			prev->second = to;
+			return true;
+		}
+	}
+
+	used[from] = to;
+	return true;
+}
+
+void sections::addLabel(std::string name, size_t bank)
+{
+	label_banks[name] = bank;
+}
+
+void sections::addRefs(size_t bank, const std::set<std::string>& names)
+{
+	bank_refs[bank].insert(names.begin(), names.end());
+}
+
+bool sections::add(const float_section& s)
+{
+	if(index.count(s.name))
+	{
+		error = s.name + " is declared twice";
+		return false;
+	}
+
+	if(s.nocross && s.size > 0x100)
+	{
+		error = s.name + " has " + std::to_string(s.size) + " bytes, more than a page";
+		return false;
+	}
+
+	index[s.name] = secs.size();
+	secs.push_back(s);
+	return true;
+}
+
+bool sections::empty()
+{
+	return secs.empty();
+}
+
+bool sections::place()
+{
+	// sections tied by with= form a group
+	std::vector<size_t> group(secs.size());
+
+	for(size_t i(0); i < secs.size(); i++)
+		group[i] = i;
+
+	auto root = [&](size_t i)
+	{
+		while(group[i] != i)
+			i = group[i];
+
+		return i;
+	};
+
+	for(size_t i(0); i < secs.size(); i++)
+	{
+		if(secs[i].with == "")
+			continue;
+
+		auto w = index.find(secs[i].with);
+
+		if(w == index.end())
+		{
+			error = secs[i].name + " goes with " + secs[i].with + ", which is no section";
+			return false;
+		}
+
+		group[root(i)] = root(w->second);
+	}
+
+	struct plan
+	{
+		std::vector<size_t> members;
+		bool fixed;
+		long bank;
+		size_t size;
+	};
+
+	std::map<size_t, plan> groups;
+
+	for(size_t i(0); i < secs.size(); i++)
+	{
+		auto& p = groups[root(i)];
+		auto& s = secs[i];
+
+		if(s.bank >= 0 && p.members.size() > 0 && p.bank >= 0 && p.bank != s.bank)
+		{
+			error = s.name + " wants bank " + std::to_string(s.bank) + ", its group bank " + std::to_string(p.bank);
+			return false;
+		}
+
+		if(p.members.empty())
+			p = {{}, false, -1, 0};
+
+		p.members.push_back(i);
+		p.fixed = p.fixed || s.fixed;
+		p.bank = s.bank >= 0 ? s.bank : p.bank;
+		p.size += s.size;
+	}
+
+	std::vector<plan> plans;
+
+	for(auto& g : groups)
+	{
+		auto p = g.second;
+
+		std::stable_sort(p.members.begin(), p.members.end(), [&](size_t a, size_t b)
+		{
+			return secs[a].size > secs[b].size;
+		});
+
+		plans.push_back(p);
+	}
+
+	// first fit decreasing, the groups with the fewest banks to choose from go first
+	std::stable_sort(plans.begin(), plans.end(), [](const plan& a, const plan& b)
+	{
+		int ra = a.bank >= 0 ? 0 : a.fixed ? 1 : 2;
+		int rb = b.bank >= 0 ? 0 : b.fixed ? 1 : 2;
+
+		if(ra != rb)
+			return ra < rb;
+
+		return a.size > b.size;
+	});
+
+	for(auto& p : plans)
+	{
+		bool found = false;
+		size_t best_bank = 0, best_cross = 0, best_waste = 0;
+		std::vector<size_t> best_adrs;
+
+		if(p.bank >= 0 && !banks.count(p.bank))
+		{
+			error = secs[p.members[0]].name + " wants bank " + std::to_string(p.bank) + ", which is not declared";
+			return false;
+		}
+
+		for(auto& b : banks)
+		{
+			if((p.bank >= 0 && b.first != (size_t)p.bank) || (p.fixed && !isFixed(b.first)))
+				continue;
+
+			bank_space space = b.second;
+			std::vector<size_t> adrs;
+			size_t waste = 0, cross = 0;
+
+			for(auto m : p.members)
+			{
+				size_t adr, gap;
+
+				if(!fit(space, secs[m], adr, gap))
+					break;
+
+				adrs.push_back(adr);
+				waste += gap - secs[m].size;
+				cross += crossings(secs[m], b.first);
+
+				if(secs[m].size > 0)
+					space.used[adr] = adr + secs[m].size;
+			}
+
+			if(adrs.size() < p.members.size())
+				continue;
+
+			if(!found || cross < best_cross || (cross == best_cross && waste < best_waste))
+			{
+				found = true;
+				best_bank = b.first;
+				best_cross = cross;
+				best_waste = waste;
+				best_adrs = adrs;
+			}
+		}
+
+		if(!found)
+		{
+			auto& s = secs[p.members[0]];
+
+			error = s.name + (p.members.size() > 1 ? " and the sections with it" : "") + " (" + std::to_string(p.size) + " bytes)";
+			error += p.members.size() > 1 ? " fit in no bank" : " fits in no bank";
+			return false;
+		}
+
+		for(size_t j(0); j < p.members.size(); j++)
+		{
+			auto& s = secs[p.members[j]];
+
+			s.placed_bank = best_bank;
+			s.address = best_adrs[j];
+			occupy(best_bank, s.address, s.address + s.size);
+
+			for(auto& l : s.labels)
+				label_banks[l] = best_bank;
+
+			addRefs(best_bank, s.refs);
+		}
+	}
+
+	return true;
+}
+
+const std::vector<float_section>& sections::getSections()
+{
+	return secs;
+}
+
+std::string sections::makeMap()
+{
+	std::stringstream r;
+
+	r << "; sfotasm bank map\n";
+
+	for(auto& b : banks)
+	{
+		auto& space = b.second;
+		size_t end = space.window + space.size;
+		size_t used = 0;
+
+		for(auto& u : space.used)
+			used += u.second - u.first;
+
+		r << "bank " << b.first << " $" << hexNum(space.window, 4) << "-$" << hexNum(end-1, 4) << ": ";
+		r << used << " of " << space.size << " bytes used, " << space.size - std::min(used, space.size) << " free\n";
+
+		std::map<size_t, const float_section*> placed;
+
+		for(auto& s : secs)
+			if(s.placed_bank == b.first && s.size > 0)
+				placed[s.address] = &s;
+
+		auto row = [&](size_t from, size_t to, std::string what)
+		{
+			if(from < to)
+				r << "\t$" << hexNum(from, 4) << "-$" << hexNum(to-1, 4) << "  " << std::left << std::setw(7) << to - from << what << "\n";
+		};
+
+		size_t adr = space.window;
+
+		for(auto& u : space.used)
+		{
+			row(adr, u.first, "free");
+			adr = u.first;
+
+			for(auto p = placed.lower_bound(u.first); p != placed.end() && p->first < u.second; p++)
+			{
+				row(adr, p->first, "pinned");
+				row(p->first, p->first + p->second->size, "section " + p->second->name);
+				adr = p->first + p->second->size;
+			}
+
+			row(adr, u.second, "pinned");
+			adr = u.second;
+		}
+
+		row(adr, end, "free");
+	}
+
+	return r.str();
+}
+
+std::string sections::getError()
+{
+	return error;
+}
+
+bool sections::isFixed(size_t bank)
+{
+	auto& a = banks[bank];
+
+	for(auto& b : banks)
+		if(b.first != bank && a.window < b.second.window + b.second.size && b.second.window < a.window + a.size)
+			return false;
+
+	return true;
+}
+
+bool sections::fit(const bank_space& b, const float_section& s, size_t& address, size_t& gap)
+{
+	bool found = false;
+	size_t from = b.window;
+	size_t end = b.window + b.size;
+
+	auto tryGap = [&](size_t g0, size_t g1)
+	{
+		size_t a = (g0 + s.align - 1) / s.align * s.align;
+
+		// move to the next page, aligned again
+		while(s.nocross && s.size > 0 && (a >> 8) != ((a + s.size - 1) >> 8) && a < g1)
+		{
+			a = (a | 0xFF) + 1;
+			a = (a + s.align - 1) / s.align * s.align;
+		}
+
+		if(a + s.size <= g1 && (!found || g1 - g0 < gap))
+		{
+			found = true;
+			address = a;
+			gap = g1 - g0;
+		}
+	};
+
+	for(auto& u : b.used)
+	{
+		if(u.first > from)
+			tryGap(from, std::min(u.first, end));
+
+		from = std::max(from, u.second);
+	}
+
+	if(from < end)
+		tryGap(from, end);
+
+	return found;
+}
+
+size_t sections::crossings(const float_section& s, size_t bank)
+{
+	size_t count = 0;
+
+	// a fixed bank is always there, going into it costs nothing
+	for(auto& r : s.refs)
+	{
+		auto l = label_banks.find(r);
+
+		if(l != label_banks.end() && l->second != bank && !isFixed(l->second))
+			count++;
+	}
+
+	if(isFixed(bank))
+		return count;
+
+	for(auto& b : bank_refs)
+		if(b.first != bank)
+			for(auto& l : s.labels)
+				count += b.second.count(l);
+
+	return count;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+
+struct float_section
+{
+	std::string name;
+	size_t size;
+
+	// constraints, bank is -1 when any bank does
+	bool fixed;
+	long bank;
+	std::string with;
+	size_t align;
+	bool nocross;
+
+	// labels inside and the symbols the lines use, for the bank choice
+	std::set<std::string> labels;
+	std::set<std::string> refs;
+
+	size_t placed_bank;
+	size_t address;
+};
+
+// .section: code and data without an address. Sections that go together
+// (with=) are placed as a group, constrained and large groups first, into the
+// bank with the fewest references across banks and there into the smallest gap
+// that fits
+class sections
+{
+public:
+	void addBank(size_t bank, size_t window, size_t size);
+	// bytes from..to-1 of bank are taken, false when some already were
+	bool occupy(size_t bank, size_t from, size_t to);
+
+	void addLabel(std::string name, size_t bank);
+	void addRefs(size_t bank, const std::set<std::string>& names);
+
+	bool add(const float_section& s);
+	bool empty();
+
+	// false when a section doesn't fit, see getError()
+	bool place();
+	const std::vector<float_section>& getSections();
+
+	// used, placed and free ranges of every bank
+	std::string makeMap();
+	std::string getError();
+private:
+	struct bank_space
+	{
+		size_t window;
+		size_t size;
+		// taken ranges, from -> to
+		std::map<size_t, size_t> used;
+	};
+
+	std::map<size_t, bank_space> banks;
+	std::map<std::string, size_t> label_banks;
+	std::map<size_t, std::set<std::string>> bank_refs;
+
+	std::vector<float_section> secs;
+	std::map<std::string, size_t> index;
+
+	std::string error;
+
+	bool isFixed(size_t bank);
+	// lowest address of the smallest gap that takes s, false when none does
+	bool fit(const bank_space& b, const float_section& s, size_t& address, size_t& gap);
+	// references between s in bank and the switchable banks it isn't in
+	size_t crossings(const float_section& s, size_t bank);
+};
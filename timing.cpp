@@ -0,0 +1,332 @@
+#include "timing.hpp"
+
+void timing::addBank(size_t bank, size_t address, const std::vector<unsigned char>& data)
+{
+	banks[bank] = {address, data};
+}
+
+void timing::addBlock(timed_block block)
+{
+	blocks.push_back(block);
+}
+
+void timing::addLoopBound(size_t address, size_t count)
+{
+	loop_bounds[address] = count;
+}
+
+std::vector<timed_block> timing::getBlocks()
+{
+	return blocks;
+}
+
+std::string timing::getError()
+{
+	return error;
+}
+
+long timing::worstCase(size_t block)
+{
+	if(results.find(block) != results.end())
+		return results[block];
+
+	if(std::find(in_progress.begin(), in_progress.end(), block) != in_progress.end())
+	{
+		error = "recursive call into timed block at $" + hexNum(blocks[block].start, 4);
+		return -1;
+	}
+
+	in_progress.push_back(block);
+
+	timed_graph g;
+	long res = -1;
+
+	if(decode(blocks[block], g))
+	{
+		std::vector<long> dist;
+		std::vector<timed_edge> exits;
+
+		if(g.code.size() == 0)
+			res = 0;
+
+		else if(propagate(g, 0, g.code.size()-1, -1, 0, dist, exits))
+		{
+			res = 0;
+
+			for(auto e : exits)
+				res = std::max(res, e.cost);
+		}
+	}
+
+	in_progress.pop_back();
+
+	if(res >= 0)
+		results[block] = res;
+
+	return res;
+}
+
+bool timing::read(size_t address, unsigned char& v)
+{
+	auto in = [&](timed_bank& b) -> bool
+	{
+		if(address < b.address || address - b.address >= b.data.size())
+			return false;
+
+		v = b.data[address - b.address];
+		return true;
+	};
+
+	auto cur = banks.find(cur_bank);
+
+	if(cur != banks.end() && in(cur->second))
+		return true;
+
+	for(auto& b : banks)
+		if(in(b.second))
+			return true;
+
+	return false;
+}
+
+bool timing::decode(timed_block& block, timed_graph& g)
+{
+	g.start = block.start;
+	g.end = block.end;
+	cur_bank = block.bank;
+
+	size_t adr = block.start;
+
+	while(adr < block.end)
+	{
+		unsigned char c, lo, hi;
+
+		if(!read(adr, c))
+		{
+			error = "no code at $" + hexNum(adr, 4);
+			return false;
+		}
+
+		opcode_info op = codes.getOpcodeInfo(c);
+
+		if(op.name == "")
+		{
+			error = "unknown opcode $" + hexNum(c, 2) + " at $" + hexNum(adr, 4);
+			return false;
+		}
+
+		timed_inst in = {adr, op, 0};
+
+		if(op.type == REL && read(adr+1, lo))
+			in.target = adr + 2 + (signed char)lo;
+
+		else if(op.type == ABS && (op.name == "JMP" || op.name == "JSR") && read(adr+1, lo) && read(adr+2, hi))
+			in.target = lo | (hi << 8);
+
+		g.index[adr] = g.code.size();
+		g.code.push_back(in);
+
+		adr += op.size;
+	}
+
+	for(size_t k(0); k < g.code.size(); k++)
+	{
+		timed_inst& in = g.code[k];
+
+		if(in.op.type != REL && !(in.op.type == ABS && in.op.name == "JMP"))
+			continue;
+
+		auto t = g.index.find(in.target);
+
+		if(t == g.index.end() || t->second > (long)k)
+			continue;
+
+		auto lb = loop_bounds.find(in.address);
+
+		if(lb == loop_bounds.end() || lb->second == 0)
+		{
+			error = "unbounded loop at $" + hexNum(in.address, 4) + ", add .loop N before it";
+			return false;
+		}
+
+		g.loops.push_back({t->second, (long)k, (long)lb->second});
+	}
+
+	for(auto l : g.loops)
+		for(auto m : g.loops)
+			if(l.header < m.header && m.header <= l.latch && l.latch < m.latch)
+			{
+				error = "loops at $" + hexNum(g.code[l.latch].address, 4) + " and $";
+				error += hexNum(g.code[m.latch].address, 4) + " overlap";
+				return false;
+			}
+
+	return true;
+}
+
+bool timing::edges(timed_graph& g, long k, std::vector<timed_edge>& out)
+{
+	timed_inst& in = g.code[k];
+
+	// indexing can't be resolved statically, so the page penalty is always paid
+	long cyc = in.op.cycles + (in.op.page_cycle ? 1 : 0);
+	long next = k+1 < (long)g.code.size() ? k+1 : -1;
+	long to = -1;
+
+	if(in.op.type == REL || in.op.name == "JMP" || in.op.name == "JSR")
+	{
+		if(in.op.type == IND)
+		{
+			error = "indirect jump at $" + hexNum(in.address, 4);
+			return false;
+		}
+
+		if(in.target >= g.start && in.target < g.end)
+		{
+			auto t = g.index.find(in.target);
+
+			if(t == g.index.end())
+			{
+				error = "jump into an instruction at $" + hexNum(in.address, 4);
+				return false;
+			}
+
+			to = t->second;
+		}
+	}
+
+	if(in.op.type == REL)
+	{
+		long taken = 1;
+
+		if(((in.address + 2) & 0xFF00) != (in.target & 0xFF00))
+			taken++;
+
+		out.push_back({next, cyc});
+		out.push_back({to, cyc + taken});
+	}
+
+	else if(in.op.name == "JMP")
+		out.push_back({to, cyc});
+
+	else if(in.op.name == "JSR")
+	{
+		long callee = -1;
+
+		for(size_t b(0); b < blocks.size(); b++)
+			if(blocks[b].start == in.target)
+				callee = b;
+
+		if(callee < 0)
+		{
+			error = "call at $" + hexNum(in.address, 4) + " to $" + hexNum(in.target, 4);
+			error += " which is not a timed block";
+			return false;
+		}
+
+		long w = worstCase(callee);
+
+		if(w < 0)
+			return false;
+
+		out.push_back({next, cyc + w});
+	}
+
+	else if(in.op.name == "RTS" || in.op.name == "RTI" || in.op.name == "BRK")
+		out.push_back({-1, cyc});
+
+	else
+		out.push_back({next, cyc});
+
+	return true;
+}
+
+bool timing::propagate(timed_graph& g, long lo, long hi, long self, long entry,
+	std::vector<long>& dist, std::vector<timed_edge>& exits)
+{
+	dist.assign(hi-lo+1, -1);
+	dist[0] = entry;
+
+	auto relay = [&](long to, long cost, long cur) -> bool
+	{
+		if(to > cur && to <= hi)
+			dist[to-lo] = std::max(dist[to-lo], cost);
+
+		else if(to < 0 || to < lo || to > hi)
+			exits.push_back({to, cost});
+
+		else
+		{
+			error = "unbounded loop at $" + hexNum(g.code[cur].address, 4);
+			return false;
+		}
+
+		return true;
+	};
+
+	for(long k(lo); k <= hi; k++)
+	{
+		long d = dist[k-lo];
+
+		if(d < 0)
+			continue;
+
+		// the outermost loop headed here is collapsed into a single step
+		long inner = -1;
+
+		for(size_t l(0); l < g.loops.size(); l++)
+			if((long)l != self && g.loops[l].header == k && g.loops[l].latch <= hi)
+				if(inner < 0 || g.loops[l].latch > g.loops[inner].latch)
+					inner = l;
+
+		if(inner >= 0)
+		{
+			timed_loop lp = g.loops[inner];
+			std::vector<long> sub;
+			std::vector<timed_edge> sub_exits;
+			std::vector<timed_edge> latch_edges;
+
+			if(!propagate(g, k, lp.latch, inner, 0, sub, sub_exits))
+				return false;
+			if(!edges(g, lp.latch, latch_edges))
+				return false;
+
+			long body = sub[lp.latch - k];
+			long iter = 0;
+
+			if(body >= 0)
+				for(auto e : latch_edges)
+					if(e.to == k)
+						iter = std::max(iter, body + e.cost);
+
+			long base = d + (lp.count-1)*iter;
+
+			for(auto e : sub_exits)
+				if(!relay(e.to, base + e.cost, lp.latch))
+					return false;
+
+			if(body >= 0)
+				for(auto e : latch_edges)
+					if(e.to != k && !relay(e.to, base + body + e.cost, lp.latch))
+						return false;
+
+			k = lp.latch;
+			continue;
+		}
+
+		// the caller accounts for the latch of the loop being unrolled
+		if(self >= 0 && k == g.loops[self].latch)
+			continue;
+
+		std::vector<timed_edge> out;
+
+		if(!edges(g, k, out))
+			return false;
+
+		for(auto e : out)
+			if(!relay(e.to, d + e.cost, k))
+				return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "opcodes.hpp"
+
+struct timed_block
+{
+	size_t start;
+	size_t end;
+	size_t max_cycles;
+	std::string instruction;
+	size_t bank;
+};
+
+// worst-case cycle counting over the control flow graph of .timed blocks
+class timing
+{
+public:
+	void addBank(size_t bank, size_t address, const std::vector<unsigned char>& data);
+	void addBlock(timed_block block);
+	void addLoopBound(size_t address, size_t count);
+
+	std::vector<timed_block> getBlocks();
+
+	// worst-case cycles of the block, -1 when it can't be bounded (see getError)
+	long worstCase(size_t block);
+	std::string getError();
+private:
+	opcodes codes;
+
+	struct timed_inst
+	{
+		size_t address;
+		opcode_info op;
+		size_t target;
+	};
+
+	struct timed_loop
+	{
+		long header;
+		long latch;
+		long count;
+	};
+
+	struct timed_edge
+	{
+		long to; // -1 leaves the block
+		long cost;
+	};
+
+	struct timed_graph
+	{
+		size_t start;
+		size_t end;
+		std::vector<timed_inst> code;
+		std::map<size_t, long> index;
+		std::vector<timed_loop> loops;
+	};
+
+	struct timed_bank
+	{
+		size_t address;
+		std::vector<unsigned char> data;
+	};
+
+	std::map<size_t, timed_bank> banks;
+	size_t cur_bank = 0;
+	std::vector<timed_block> blocks;
+	std::map<size_t, size_t> loop_bounds;
+	std::map<size_t, long> results;
+	std::vector<size_t> in_progress;
+	std::string error;
+
+	// from the bank of the block being decoded, then from any bank mapped there
+	bool read(size_t address, unsigned char& v);
+
+	bool decode(timed_block& block, timed_graph& g);
+	bool edges(timed_graph& g, long k, std::vector<timed_edge>& out);
+
+	// longest paths through [lo, hi] where self is the loop being unrolled (or -1)
+	bool propagate(timed_graph& g, long lo, long hi, long self, long entry,
+		std::vector<long>& dist, std::vector<timed_edge>& exits);
+};
@@ -0,0 +1,154 @@
+#include "variables.hpp"
+#include "opcodes.hpp"
+
+#include <iomanip>
+
+void variables::setZeroPage(size_t from, size_t to)
+{
+	zp_from = from;
+	zp_to = to;
+}
+
+void variables::setRam(size_t from, size_t to)
+{
+	ram_from = from;
+	ram_to = to;
+}
+
+bool variables::declare(std::string name, size_t size, VAR_HINT hint)
+{
+	if(index.find(name) != index.end())
+		return false;
+
+	index[name] = vars.size();
+	vars.push_back({name, size, hint, 0, 0, 0, false});
+
+	return true;
+}
+
+bool variables::isVariable(std::string name)
+{
+	return index.find(name) != index.end();
+}
+
+bool variables::empty()
+{
+	return vars.empty();
+}
+
+void variables::addReference(std::string name, double weight, bool shorter)
+{
+	auto& v = vars[index[name]];
+
+	v.uses++;
+
+	if(shorter)
+		v.refs += weight;
+}
+
+void variables::requireZeroPage(std::string name)
+{
+	auto& v = vars[index[name]];
+
+	if(v.hint == VAR_ANY)
+		v.hint = VAR_ZP;
+}
+
+bool variables::allocate()
+{
+	std::vector<size_t> order;
+
+	for(size_t i(0); i < vars.size(); i++)
+		order.push_back(i);
+
+	// required ones first, then by references per byte
+	std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r)
+	{
+		if((vars[l].hint == VAR_ZP) != (vars[r].hint == VAR_ZP))
+			return vars[l].hint == VAR_ZP;
+
+		return vars[l].refs / vars[l].size > vars[r].refs / vars[r].size;
+	});
+
+	size_t zp = zp_from;
+	size_t ram = ram_from;
+
+	for(auto i : order)
+	{
+		auto& v = vars[i];
+
+		v.zp = v.hint != VAR_RAM && v.refs + (v.hint == VAR_ZP) > 0 && zp + v.size <= zp_to + 1;
+
+		if(v.zp)
+		{
+			v.address = zp;
+			zp += v.size;
+			continue;
+		}
+
+		if(v.hint == VAR_ZP)
+		{
+			error = v.name + " doesn't fit in zero page";
+			return false;
+		}
+
+		if(ram + v.size > ram_to + 1)
+		{
+			error = v.name + " doesn't fit in RAM";
+			return false;
+		}
+
+		v.address = ram;
+		ram += v.size;
+	}
+
+	return true;
+}
+
+std::map<std::string, size_t> variables::getAddresses()
+{
+	std::map<std::string, size_t> adrs;
+
+	for(auto& v : vars)
+		adrs[v.name] = v.address;
+
+	return adrs;
+}
+
+const std::vector<variable>& variables::getVariables()
+{
+	return vars;
+}
+
+std::string variables::makeReport()
+{
+	std::vector<variable> sorted = vars;
+
+	std::stable_sort(sorted.begin(), sorted.end(),
+		[](const variable& l, const variable& r) { return l.address < r.address; });
+
+	std::stringstream r;
+	size_t zp_used = 0;
+
+	for(auto& v : vars)
+		if(v.zp)
+			zp_used += v.size;
+
+	r << "; sfotasm variables\n";
+	r << "; zero page: " << zp_used << " of " << zp_to - zp_from + 1 << " bytes\n";
+	r << std::left << std::setw(32) << "name" << std::setw(9) << "address";
+	r << std::setw(6) << "size" << "references\n";
+
+	for(auto& v : sorted)
+	{
+		r << std::setw(32) << v.name << std::setw(9) << ("$" + hexNum(v.address, 4));
+		r << std::setw(6) << v.size << v.uses << "\n";
+	}
+
+	return r.str();
+}
+
+std::string variables::getError()
+{
+	return error;
+}
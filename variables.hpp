@@ -0,0 +1,65 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+enum VAR_HINT
+{
+	VAR_ANY,
+	VAR_ZP,
+	VAR_RAM
+};
+
+struct variable
+{
+	std::string name;
+	size_t size;
+	VAR_HINT hint;
+	// references that get shorter in zero page, weighted by profile counts,
+	// for the ranking
+	double refs;
+	// every reference, for the report
+	size_t uses;
+	size_t address;
+	bool zp;
+};
+
+// .var allocation: the most referenced bytes go to zero page, the rest to RAM
+class variables
+{
+public:
+	// inclusive address ranges (.varzp, .varram)
+	void setZeroPage(size_t from, size_t to);
+	void setRam(size_t from, size_t to);
+
+	// false when name is declared twice
+	bool declare(std::string name, size_t size, VAR_HINT hint);
+	bool isVariable(std::string name);
+	bool empty();
+
+	// shorter when the reference gets shorter in zero page
+	void addReference(std::string name, double weight, bool shorter);
+	// (ptr),Y and (ptr,X) pointers only work in zero page
+	void requireZeroPage(std::string name);
+
+	// false when the variables don't fit, see getError()
+	bool allocate();
+
+	// addresses of every variable after allocate()
+	std::map<std::string, size_t> getAddresses();
+	const std::vector<variable>& getVariables();
+
+	std::string makeReport();
+	std::string getError();
+private:
+	std::vector<variable> vars;
+	std::map<std::string, size_t> index;
+
+	size_t zp_from = 0x00;
+	size_t zp_to = 0xFF;
+	size_t ram_from = 0x0300;
+	size_t ram_to = 0x07FF;
+
+	std::string error;
+};